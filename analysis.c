@@ -0,0 +1,1140 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    Based on sndfile-tools waveform by Erik de Castro Lopo.
+        waveform.c - v1.04
+        Copyright (C) 2007-2012 Erik de Castro Lopo <erikd@mega-nerd.com>
+        Copyright (C) 2012 Robin Gareus <robin@gareus.org>
+        Copyright (C) 2013 driedfruit <driedfruit@mindloop.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include <deadbeef/deadbeef.h>
+
+#include "analysis.h"
+#include "cache.h"
+#include "meter.h"
+#include "tap.h"
+#include "pcm.h"
+#include "mp3.h"
+#include "throttle.h"
+#include "utils.h"
+#include "worker.h"
+#include "waveform.h"
+
+// columns analyzed in one go before looking at the focus again
+#define ANALYSIS_CHUNK_COLUMNS (32)
+// seconds behind the play position before a column is decoded in tap mode
+#define ANALYSIS_TAP_MARGIN (1)
+// frames per decoder read, keeps memory use independent of track length
+#define ANALYSIS_READ_FRAMES (16384)
+// blocks of decoded PCM between the decode and the reduce thread
+#define ANALYSIS_PIPE_BLOCKS (4)
+// yields before a thread of the pipe blocks until the other one moves on
+#define ANALYSIS_PIPE_SPINS (64)
+// seconds between two progress updates
+#define ANALYSIS_PROGRESS_INTERVAL (0.1)
+// seconds between two checkpoints of a running analysis
+#define ANALYSIS_CHECKPOINT_INTERVAL (10)
+// number of seek points and time budget of the preview pass
+#define ANALYSIS_PREVIEW_POINTS (256)
+#define ANALYSIS_PREVIEW_BUDGET (0.1)
+// frames decoded at each preview point, 20 ms
+#define ANALYSIS_PREVIEW_FRAMES(samplerate) ((samplerate) / 50)
+// microseconds to wait before looking again while the system is busy
+#define ANALYSIS_THROTTLE_WAIT (250000)
+
+#ifndef MIN
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#endif
+#ifndef MAX
+#define MAX(a,b) (((a)>(b))?(a):(b))
+#endif
+#ifndef CLAMP
+#define CLAMP(x,low,high) (((x)>(high))?(high):(((x)<(low))?(low):(x)))
+#endif
+
+static DB_decoder_t *
+waveform_analysis_decoder_get (DB_playItem_t *it)
+{
+    char decoder_id[100] = "";
+    deadbeef->pl_lock ();
+    const char *dec_meta = deadbeef->pl_find_meta_raw (it, ":DECODER");
+    if (dec_meta) {
+        strncpy (decoder_id, dec_meta, sizeof (decoder_id) - 1);
+    }
+    deadbeef->pl_unlock ();
+
+    DB_decoder_t **decoders = deadbeef->plug_get_decoder_list ();
+    for (int i = 0; decoders[i]; i++) {
+        if (!strcmp (decoders[i]->plugin.id, decoder_id)) {
+            return decoders[i];
+        }
+    }
+    return NULL;
+}
+
+static double
+waveform_analysis_time (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// first frame after the given column
+static int64_t
+waveform_analysis_column_end (waveform_analysis_t *a, int column)
+{
+    return (column + 1) * a->total_frames / a->num_columns;
+}
+
+// first frame of the given column
+static int64_t
+waveform_analysis_column_start (waveform_analysis_t *a, int column)
+{
+    return column > 0 ? waveform_analysis_column_end (a, column - 1) : 0;
+}
+
+// first column still to do at or after the given one, wrapping around
+static int
+waveform_analysis_next_column (waveform_analysis_t *a, int column)
+{
+    for (int i = 0; i < a->num_columns; i++) {
+        const int c = (column + i) % a->num_columns;
+        if (!a->column_done[c]) {
+            return c;
+        }
+    }
+    return -1;
+}
+
+static int
+waveform_analysis_frame_column (waveform_analysis_t *a, int64_t frame)
+{
+    const int64_t column = frame * a->num_columns / a->total_frames;
+    return (int)CLAMP (column, 0, a->num_columns - 1);
+}
+
+static int64_t
+waveform_analysis_focus_frame (waveform_analysis_t *a)
+{
+    if (!a->focus) {
+        return -1;
+    }
+    const float seconds = a->focus (a, a->user_data);
+    if (seconds < 0 || a->total_frames <= 0) {
+        return -1;
+    }
+    return (int64_t)((double)seconds * a->samplerate);
+}
+
+// number of leading columns playback won't pass again, the playback tap is
+// left to fill in everything after that
+static int
+waveform_analysis_tap_limit (waveform_analysis_t *a, int64_t focus_frame)
+{
+    const int64_t margin = (int64_t)a->samplerate * ANALYSIS_TAP_MARGIN;
+    if (focus_frame + margin >= a->total_frames) {
+        return a->num_columns;
+    }
+    if (focus_frame < margin) {
+        return 0;
+    }
+    return waveform_analysis_frame_column (a, focus_frame - margin);
+}
+
+// Play position in seconds from which column is below the tap limit. A
+// column that is still ahead of the play position is left to the tap until
+// the last margin of the track.
+static float
+waveform_analysis_tap_wake (waveform_analysis_t *a, int column, int64_t focus_frame)
+{
+    const int64_t margin = (int64_t)a->samplerate * ANALYSIS_TAP_MARGIN;
+    int64_t frame = a->total_frames - margin;
+    if (waveform_analysis_column_start (a, column) <= focus_frame) {
+        frame = MIN (frame, waveform_analysis_column_end (a, column) + margin);
+    }
+    return (float)((double)frame / a->samplerate);
+}
+
+static int
+waveform_analysis_seek (DB_decoder_t *dec, DB_fileinfo_t *fileinfo, const waveform_pcm_t *pcm, int64_t position)
+{
+    if (pcm) {
+        return position <= pcm->frames ? 0 : -1;
+    }
+    if (dec->seek_sample && position <= INT32_MAX) {
+        return dec->seek_sample (fileinfo, (int)position);
+    }
+    if (dec->seek) {
+        return dec->seek (fileinfo, (float)((double)position / fileinfo->fmt.samplerate));
+    }
+    return -1;
+}
+
+// Maps uncompressed local files so they can be read without the decoder.
+// A subtrack gets the part of the file it covers.
+static int
+waveform_analysis_pcm_open (waveform_analysis_t *a, waveform_pcm_t *pcm)
+{
+    memset (pcm, 0, sizeof (waveform_pcm_t));
+    deadbeef->pl_lock ();
+    const char *uri_meta = deadbeef->pl_find_meta_raw (a->it, ":URI");
+    char *uri = uri_meta && deadbeef->is_local_file (uri_meta) ? strdup (uri_meta) : NULL;
+    deadbeef->pl_unlock ();
+    if (!uri) {
+        return -1;
+    }
+    const int res = waveform_pcm_open (pcm, uri);
+    free (uri);
+    if (res != 0) {
+        return -1;
+    }
+    if (deadbeef->pl_get_item_flags (a->it) & DDB_IS_SUBTRACK) {
+        const int64_t start = a->it->startsample;
+        const int64_t end = (int64_t)a->it->endsample + 1;
+        if (start < 0 || start >= pcm->frames || end <= start) {
+            waveform_pcm_close (pcm);
+            return -1;
+        }
+        pcm->data += start * pcm->channels * (pcm->bps / 8);
+        pcm->frames = MIN (pcm->frames - start, end - start);
+    }
+    return 0;
+}
+
+// Fills wavedata with the estimate of a local MP3 file. Returns its number
+// of channels, or 0 if there is none.
+static int
+waveform_analysis_mp3_envelope (waveform_analysis_t *a, float duration)
+{
+    deadbeef->pl_lock ();
+    const char *uri_meta = deadbeef->pl_find_meta_raw (a->it, ":URI");
+    const char *file_meta = deadbeef->pl_find_meta_raw (a->it, ":FILETYPE");
+    char *uri = uri_meta && file_meta && !strcmp (file_meta, "MP3") && deadbeef->is_local_file (uri_meta) ? strdup (uri_meta) : NULL;
+    deadbeef->pl_unlock ();
+    if (!uri) {
+        return 0;
+    }
+    const int64_t start = deadbeef->pl_get_item_flags (a->it) & DDB_IS_SUBTRACK ? a->it->startsample : 0;
+    const int channels = waveform_mp3_envelope (uri, start, duration, a->num_columns, a->wavedata->data, a->data_size);
+    trace ("waveform: mp3 estimate with %d channels. (%s)\n", channels, a->key);
+    free (uri);
+    return channels > 0 && channels <= MAX_CHANNELS ? channels : 0;
+}
+
+// Read ahead hints for local files. Compressed subtracks are left alone,
+// there is no telling where in the file they are.
+static void
+waveform_analysis_readahead_open (waveform_analysis_t *a, const waveform_pcm_t *pcm, waveform_readahead_t *readahead)
+{
+    readahead->fd = -1;
+    if (!pcm && (deadbeef->pl_get_item_flags (a->it) & DDB_IS_SUBTRACK)) {
+        return;
+    }
+    deadbeef->pl_lock ();
+    const char *uri_meta = deadbeef->pl_find_meta_raw (a->it, ":URI");
+    char *uri = uri_meta && deadbeef->is_local_file (uri_meta) ? strdup (uri_meta) : NULL;
+    deadbeef->pl_unlock ();
+    if (uri) {
+        waveform_readahead_open (readahead, uri, pcm ? pcm->map : NULL);
+        free (uri);
+    }
+}
+
+// Hints the bytes of frames start to end, estimated from the duration for
+// compressed files. Pages behind are only dropped for batch jobs, whose
+// tracks are not about to be played.
+static void
+waveform_analysis_readahead (waveform_analysis_t *a, waveform_readahead_t *readahead, const waveform_pcm_t *pcm, int64_t start, int64_t end)
+{
+    if (readahead->fd < 0 || a->total_frames <= 0) {
+        return;
+    }
+    const int drop_behind = a->priority == JOB_PRIORITY_BATCH;
+    if (pcm) {
+        const int64_t framesize = pcm->channels * (pcm->bps / 8);
+        const int64_t base = pcm->data - (const unsigned char *)pcm->map;
+        waveform_readahead_advise (readahead, base + start * framesize, (end - start) * framesize, drop_behind);
+    }
+    else {
+        const double bytes_per_frame = (double)readahead->size / a->total_frames;
+        waveform_readahead_advise (readahead, (int64_t)(start * bytes_per_frame), (int64_t)((end - start) * bytes_per_frame), drop_behind);
+    }
+}
+
+// Waits while the system is busy. The load average is not checked for the
+// playing track. Returns -1 if the job was cancelled meanwhile.
+static int
+waveform_analysis_throttle (waveform_analysis_t *a)
+{
+    const float max_load = a->priority == JOB_PRIORITY_PLAYING ? 0 : a->max_load;
+    while (waveform_throttle_busy (max_load, a->min_buffer_ms)) {
+        if (queue_is_cancelled (a->key)) {
+            return -1;
+        }
+        usleep (ANALYSIS_THROTTLE_WAIT);
+    }
+    return 0;
+}
+
+static int
+waveform_analysis_decoder_listed (const char *id, const char *list)
+{
+    const size_t id_len = strlen (id);
+    const char *p = list;
+    while (*p) {
+        p += strspn (p, " ,;");
+        const size_t len = strcspn (p, " ,;");
+        if (len == id_len && !strncmp (p, id, len)) {
+            return 1;
+        }
+        p += len;
+    }
+    return 0;
+}
+
+// Seeks to evenly spaced points and decodes a few milliseconds at each one,
+// giving a rough envelope of the whole track before the full pass starts.
+// Points are visited coarse to fine, so running out of time still leaves an
+// evenly spread (if coarser) result. Returns 1 if the decoder was moved.
+static int
+waveform_analysis_preview (waveform_analysis_t *a,
+                           DB_decoder_t *dec,
+                           DB_fileinfo_t *fileinfo,
+                           char *buffer,
+                           float *data,
+                           ddb_waveformat_t *out_fmt)
+{
+    const int channels = a->channels;
+    const int samplesize = channels * (fileinfo->fmt.bps / 8);
+    const int first = a->columns_done;
+    const int num_columns = a->num_columns - first;
+    const int num_points = MIN (ANALYSIS_PREVIEW_POINTS, num_columns);
+    const int frames_wanted = MIN (MAX (1, ANALYSIS_PREVIEW_FRAMES (fileinfo->fmt.samplerate)), ANALYSIS_READ_FRAMES);
+    if (num_points <= 1) {
+        return 0;
+    }
+
+    char *sampled = calloc (num_points, 1);
+    short *values = calloc (num_points * channels * VALUES_PER_SAMPLE, sizeof (short));
+    if (!sampled || !values) {
+        free (sampled);
+        free (values);
+        return 0;
+    }
+
+    const double start = waveform_analysis_time ();
+    int step = 1;
+    while (step * 2 < num_points) {
+        step *= 2;
+    }
+    int out_of_time = 0;
+    for (; step > 0 && !out_of_time; step /= 2) {
+        for (int p = 0; p < num_points; p += step) {
+            if (sampled[p]) {
+                continue;
+            }
+            if (waveform_analysis_time () - start > ANALYSIS_PREVIEW_BUDGET) {
+                out_of_time = 1;
+                break;
+            }
+            const int column = first + (int)((int64_t)p * num_columns / num_points);
+            if (waveform_analysis_seek (dec, fileinfo, NULL, waveform_analysis_column_start (a, column)) != 0) {
+                out_of_time = 1;
+                break;
+            }
+            const int sz = dec->read (fileinfo, buffer, frames_wanted * samplesize);
+            const int frames_read = sz > 0 ? sz / samplesize : 0;
+            sampled[p] = 1;
+            if (frames_read <= 0) {
+                continue;
+            }
+            deadbeef->pcm_convert (&fileinfo->fmt, buffer, out_fmt, (char *)data, frames_read * samplesize);
+
+            short *point = values + p * channels * VALUES_PER_SAMPLE;
+            for (int ch = 0; ch < channels; ch++) {
+                float max = -1.0;
+                float min = 1.0;
+                float sum = 0.0;
+                for (int sample = 0; sample < frames_read; sample++) {
+                    const float sample_val = data[sample * channels + ch];
+                    max = MAX (max, sample_val);
+                    min = MIN (min, sample_val);
+                    sum += sample_val * sample_val;
+                }
+                point[0] = (short)(max*1000);
+                point[1] = (short)(min*1000);
+                point[2] = (short)(sqrt (sum / frames_read)*1000);
+                point += VALUES_PER_SAMPLE;
+            }
+        }
+    }
+
+    // every column takes the closest sampled point at or before it
+    const int column_size = channels * VALUES_PER_SAMPLE;
+    int last = 0;
+    for (int c = 0; c < num_columns; c++) {
+        const int p = (int)((int64_t)c * num_points / num_columns);
+        if (sampled[p]) {
+            last = p;
+        }
+        memcpy (a->wavedata->data + (first + c) * column_size, values + last * column_size, column_size * sizeof (short));
+    }
+    trace ("waveform: preview took %f s. (%s)\n", waveform_analysis_time () - start, a->key);
+
+    free (sampled);
+    free (values);
+    return 1;
+}
+
+static const char *
+waveform_analysis_checkpoint_key (waveform_analysis_t *a)
+{
+    return a->checkpoint_key ? a->checkpoint_key : a->key;
+}
+
+// only the leading run of finished columns is stored, columns done out of
+// order after a seek are redone on resume
+static void
+waveform_analysis_checkpoint_save (waveform_analysis_t *a)
+{
+    int done = 0;
+    while (done < a->num_columns && a->column_done[done]) {
+        done++;
+    }
+    if (!a->checkpoints || done <= 0 || done >= a->num_columns) {
+        return;
+    }
+    const int len = done * a->channels * VALUES_PER_SAMPLE;
+    short *blob = a->wavedata->data;
+    int blob_len = len;
+    if (a->features) {
+        // meter values follow the columns in the same blob
+        blob_len = len + done * METER_VALUES;
+        blob = malloc (sizeof (short) * blob_len);
+        if (!blob) {
+            return;
+        }
+        memcpy (blob, a->wavedata->data, sizeof (short) * len);
+        memcpy (blob + len, a->features, sizeof (short) * done * METER_VALUES);
+    }
+    waveform_db_checkpoint_write (waveform_analysis_checkpoint_key (a),
+                                  blob,
+                                  blob_len * sizeof (short),
+                                  a->channels,
+                                  a->num_columns,
+                                  done,
+                                  waveform_analysis_column_end (a, done - 1));
+    if (blob != a->wavedata->data) {
+        free (blob);
+    }
+    trace ("waveform: checkpoint at column %d. (%s)\n", done, a->key);
+}
+
+static int
+waveform_analysis_checkpoint_restore (waveform_analysis_t *a, DB_decoder_t *dec, DB_fileinfo_t *fileinfo, const waveform_pcm_t *pcm)
+{
+    if (!a->checkpoints) {
+        return 0;
+    }
+    int channels = 0;
+    int columns = 0;
+    int done = 0;
+    int64_t position = 0;
+    short *blob = a->wavedata->data;
+    size_t blob_size = a->data_size;
+    if (a->features) {
+        blob_size = a->data_size + (size_t)a->num_columns * METER_VALUES;
+        blob = malloc (sizeof (short) * blob_size);
+        if (!blob) {
+            return 0;
+        }
+    }
+    const int len = waveform_db_checkpoint_read (waveform_analysis_checkpoint_key (a),
+                                                 blob,
+                                                 blob_size,
+                                                 &channels,
+                                                 &columns,
+                                                 &done,
+                                                 &position);
+    const int wave_len = done * channels * VALUES_PER_SAMPLE;
+    const int feature_len = a->features ? done * METER_VALUES : 0;
+    if (len > 0
+        && channels == a->channels
+        && columns == a->num_columns
+        && done > 0
+        && done < columns
+        && len == wave_len + feature_len
+        && position == waveform_analysis_column_end (a, done - 1)
+        && waveform_analysis_seek (dec, fileinfo, pcm, position) == 0) {
+        if (a->features) {
+            memcpy (a->wavedata->data, blob, sizeof (short) * wave_len);
+            memcpy (a->features, blob + wave_len, sizeof (short) * feature_len);
+            free (blob);
+        }
+        memset (a->column_done, 1, done);
+        a->columns_done = done;
+        a->position = position;
+        trace ("waveform: resuming at column %d. (%s)\n", done, a->key);
+        return 1;
+    }
+    if (a->features) {
+        free (blob);
+    }
+    if (len <= 0) {
+        return 0;
+    }
+    // stale or from a different setup
+    waveform_db_checkpoint_delete (waveform_analysis_checkpoint_key (a));
+    memset (a->wavedata->data, 0, sizeof (short) * a->data_size);
+    return 0;
+}
+
+static void
+waveform_analysis_store_column (waveform_analysis_t *a, int column, float *max, float *min, float *sum, int64_t frames)
+{
+    const int channels = a->channels;
+    short *values = a->wavedata->data + column * channels * VALUES_PER_SAMPLE;
+    for (int ch = 0; ch < channels; ch++) {
+        values[0] = frames > 0 ? (short)(max[ch]*1000) : 0;
+        values[1] = frames > 0 ? (short)(min[ch]*1000) : 0;
+        values[2] = frames > 0 ? (short)(sqrt (sum[ch] / frames)*1000) : 0;
+        values += VALUES_PER_SAMPLE;
+        max[ch] = -1.0;
+        min[ch] = 1.0;
+        sum[ch] = 0.0;
+    }
+}
+
+// Hands the columns stored since the last update to the progress callback.
+static void
+waveform_analysis_publish (waveform_analysis_t *a, int *first, int *last)
+{
+    if (a->progress && *first < *last) {
+        a->progress (a, *first, *last - *first, a->user_data);
+    }
+    *first = a->num_columns;
+    *last = 0;
+}
+
+// The decoder runs on a thread of its own and hands blocks of converted PCM
+// to the analysis thread through a single producer, single consumer ring.
+// Each side only writes its own index and moves it with an atomic store. A
+// full ring holds the decoder back, an empty one the reduction; only then
+// does a side take the mutex to sleep, and the other side signals only
+// while it sees a sleeper.
+typedef struct
+{
+    int frames;
+    int eof;
+    // the block finishes the request
+    int last;
+    float *data;
+} analysis_block_t;
+
+typedef struct
+{
+    waveform_analysis_t *a;
+    DB_decoder_t *dec;
+    DB_fileinfo_t *fileinfo;
+    // read from instead of the decoder if set
+    const waveform_pcm_t *pcm;
+    const ddb_waveformat_t *out_fmt;
+    char *buffer;
+    int samplesize;
+    intptr_t tid;
+    // held to sleep on and to signal moves of request, head, tail and quit
+    // while sleepers is non-zero
+    uintptr_t mutex;
+    uintptr_t cond;
+    int sleepers;
+
+    // columns first to last - 1, decoded from frame position on; published
+    // by incrementing request
+    int first;
+    int last;
+    int64_t position;
+    unsigned request;
+    int abort;
+    int quit;
+
+    analysis_block_t blocks[ANALYSIS_PIPE_BLOCKS];
+    unsigned head;
+    unsigned tail;
+} analysis_pipe_t;
+
+// Waits until the other thread moves value away from seen or quit is set,
+// spinning briefly before going to sleep.
+static void
+waveform_analysis_pipe_wait (analysis_pipe_t *pipeline, const unsigned *value, unsigned seen)
+{
+    for (int spins = 0; spins < ANALYSIS_PIPE_SPINS; spins++) {
+        if (__atomic_load_n (value, __ATOMIC_ACQUIRE) != seen || __atomic_load_n (&pipeline->quit, __ATOMIC_ACQUIRE)) {
+            return;
+        }
+        sched_yield ();
+    }
+    // announced before value is looked at again, a store either comes
+    // before that look or sees the sleeper
+    deadbeef->mutex_lock (pipeline->mutex);
+    __atomic_add_fetch (&pipeline->sleepers, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n (value, __ATOMIC_SEQ_CST) == seen && !__atomic_load_n (&pipeline->quit, __ATOMIC_SEQ_CST)) {
+        deadbeef->cond_wait (pipeline->cond, pipeline->mutex);
+    }
+    __atomic_sub_fetch (&pipeline->sleepers, 1, __ATOMIC_RELAXED);
+    deadbeef->mutex_unlock (pipeline->mutex);
+}
+
+static void
+waveform_analysis_pipe_store (analysis_pipe_t *pipeline, unsigned *value, unsigned v)
+{
+    __atomic_store_n (value, v, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n (&pipeline->sleepers, __ATOMIC_SEQ_CST)) {
+        deadbeef->mutex_lock (pipeline->mutex);
+        deadbeef->cond_broadcast (pipeline->cond);
+        deadbeef->mutex_unlock (pipeline->mutex);
+    }
+}
+
+static analysis_block_t *
+waveform_analysis_pipe_free_block (analysis_pipe_t *pipeline)
+{
+    while (pipeline->head - __atomic_load_n (&pipeline->tail, __ATOMIC_ACQUIRE) >= ANALYSIS_PIPE_BLOCKS) {
+        waveform_analysis_pipe_wait (pipeline, &pipeline->tail, pipeline->head - ANALYSIS_PIPE_BLOCKS);
+    }
+    return &pipeline->blocks[pipeline->head % ANALYSIS_PIPE_BLOCKS];
+}
+
+static void
+waveform_analysis_pipe_publish (analysis_pipe_t *pipeline)
+{
+    waveform_analysis_pipe_store (pipeline, &pipeline->head, pipeline->head + 1);
+}
+
+// Reads are a fixed size regardless of the column width, column boundaries
+// are left to the analysis side.
+static void
+waveform_analysis_pipe_decode (analysis_pipe_t *pipeline)
+{
+    // the request may be replaced as soon as its last block is taken
+    const int64_t end = waveform_analysis_column_end (pipeline->a, pipeline->last - 1);
+    int64_t position = pipeline->position;
+    for (;;) {
+        if (__atomic_load_n (&pipeline->abort, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        analysis_block_t *block = waveform_analysis_pipe_free_block (pipeline);
+        const int frames_wanted = (int)MIN (ANALYSIS_READ_FRAMES, MAX (0, end - position));
+        int frames_read = 0;
+        int eof = 0;
+        if (frames_wanted > 0 && pipeline->pcm) {
+            frames_read = (int)MIN (frames_wanted, MAX (0, pipeline->pcm->frames - position));
+            eof = frames_read < frames_wanted;
+            if (frames_read > 0) {
+                waveform_pcm_read (pipeline->pcm, position, frames_read, block->data);
+            }
+        }
+        else if (frames_wanted > 0) {
+            const int bytes_wanted = frames_wanted * pipeline->samplesize;
+            const int sz = pipeline->dec->read (pipeline->fileinfo, pipeline->buffer, bytes_wanted);
+            frames_read = sz > 0 ? sz / pipeline->samplesize : 0;
+            eof = sz < bytes_wanted;
+            if (frames_read > 0) {
+                deadbeef->pcm_convert (&pipeline->fileinfo->fmt, pipeline->buffer, pipeline->out_fmt, (char *)block->data, frames_read * pipeline->samplesize);
+            }
+        }
+        position += frames_read;
+        block->frames = frames_read;
+        block->eof = eof;
+        block->last = eof || position >= end;
+        const int done = block->last;
+        waveform_analysis_pipe_publish (pipeline);
+        if (done) {
+            return;
+        }
+    }
+
+    analysis_block_t *block = waveform_analysis_pipe_free_block (pipeline);
+    block->frames = 0;
+    block->eof = 0;
+    block->last = 1;
+    waveform_analysis_pipe_publish (pipeline);
+}
+
+static void
+waveform_analysis_pipe_thread (void *ctx)
+{
+    analysis_pipe_t *pipeline = ctx;
+    unsigned handled = 0;
+    if (pipeline->a->idle_io) {
+        waveform_throttle_io_priority (pipeline->a->priority != JOB_PRIORITY_PLAYING);
+    }
+    for (;;) {
+        while (__atomic_load_n (&pipeline->request, __ATOMIC_ACQUIRE) == handled) {
+            if (__atomic_load_n (&pipeline->quit, __ATOMIC_ACQUIRE)) {
+                return;
+            }
+            waveform_analysis_pipe_wait (pipeline, &pipeline->request, handled);
+        }
+        handled++;
+        waveform_analysis_pipe_decode (pipeline);
+    }
+}
+
+static int
+waveform_analysis_pipe_start (analysis_pipe_t *pipeline)
+{
+    const size_t block_size = sizeof (float) * ANALYSIS_READ_FRAMES * pipeline->a->channels;
+    pipeline->mutex = deadbeef->mutex_create_nonrecursive ();
+    pipeline->cond = deadbeef->cond_create ();
+    if (!pipeline->mutex || !pipeline->cond) {
+        return -1;
+    }
+    for (int i = 0; i < ANALYSIS_PIPE_BLOCKS; i++) {
+        pipeline->blocks[i].data = malloc (block_size);
+        if (!pipeline->blocks[i].data) {
+            return -1;
+        }
+    }
+    pipeline->tid = deadbeef->thread_start_low_priority (waveform_analysis_pipe_thread, pipeline);
+    return pipeline->tid ? 0 : -1;
+}
+
+static void
+waveform_analysis_pipe_stop (analysis_pipe_t *pipeline)
+{
+    if (pipeline->tid) {
+        deadbeef->mutex_lock (pipeline->mutex);
+        __atomic_store_n (&pipeline->quit, 1, __ATOMIC_RELEASE);
+        deadbeef->cond_broadcast (pipeline->cond);
+        deadbeef->mutex_unlock (pipeline->mutex);
+        deadbeef->thread_join (pipeline->tid);
+        pipeline->tid = 0;
+    }
+    for (int i = 0; i < ANALYSIS_PIPE_BLOCKS; i++) {
+        free (pipeline->blocks[i].data);
+        pipeline->blocks[i].data = NULL;
+    }
+    if (pipeline->cond) {
+        deadbeef->cond_free (pipeline->cond);
+        pipeline->cond = 0;
+    }
+    if (pipeline->mutex) {
+        deadbeef->mutex_free (pipeline->mutex);
+        pipeline->mutex = 0;
+    }
+}
+
+// Must only be called while the decoder thread is idle, i.e. after the block
+// marked last of the previous request was taken.
+static void
+waveform_analysis_pipe_request (analysis_pipe_t *pipeline, int first, int last, int64_t position)
+{
+    pipeline->first = first;
+    pipeline->last = last;
+    pipeline->position = position;
+    __atomic_store_n (&pipeline->abort, 0, __ATOMIC_RELAXED);
+    waveform_analysis_pipe_store (pipeline, &pipeline->request, pipeline->request + 1);
+}
+
+static analysis_block_t *
+waveform_analysis_pipe_next (analysis_pipe_t *pipeline)
+{
+    while (__atomic_load_n (&pipeline->head, __ATOMIC_ACQUIRE) == pipeline->tail) {
+        waveform_analysis_pipe_wait (pipeline, &pipeline->head, pipeline->tail);
+    }
+    return &pipeline->blocks[pipeline->tail % ANALYSIS_PIPE_BLOCKS];
+}
+
+static void
+waveform_analysis_pipe_release (analysis_pipe_t *pipeline)
+{
+    waveform_analysis_pipe_store (pipeline, &pipeline->tail, pipeline->tail + 1);
+}
+
+static int
+waveform_analysis_decode (waveform_analysis_t *a)
+{
+    int result = 0;
+    char *buffer = NULL;
+    float *data = NULL;
+    waveform_meter_t *meter = NULL;
+    int64_t meter_position = -1;
+    wavedata_t *wavedata = a->wavedata;
+    analysis_pipe_t pipeline;
+    memset (&pipeline, 0, sizeof (pipeline));
+    waveform_readahead_t readahead = { .fd = -1 };
+
+    wavedata->data_len = 0;
+    wavedata->channels = 0;
+    a->channels = 0;
+    a->columns_done = 0;
+    a->column_done = NULL;
+    a->position = 0;
+    a->approximate = 0;
+
+    if (a->mp3_envelope && a->approximate_only) {
+        const int channels = waveform_analysis_mp3_envelope (a, deadbeef->pl_get_item_duration (a->it));
+        if (channels > 0) {
+            a->channels = channels;
+            a->columns_done = a->num_columns;
+            a->approximate = 1;
+            wavedata->data_len = a->num_columns * channels * VALUES_PER_SAMPLE;
+            wavedata->channels = channels;
+            return 1;
+        }
+    }
+
+    DB_decoder_t *dec = NULL;
+    DB_fileinfo_t *fileinfo = NULL;
+    waveform_pcm_t pcm;
+    const int raw = waveform_analysis_pcm_open (a, &pcm) == 0;
+    if (!raw) {
+        dec = waveform_analysis_decoder_get (a->it);
+        if (!dec || !dec->open) {
+            return 0;
+        }
+        fileinfo = dec->open (0);
+        if (!fileinfo) {
+            return 0;
+        }
+        if (dec->init (fileinfo, DB_PLAYITEM (a->it)) != 0) {
+            deadbeef->pl_lock ();
+            fprintf (stderr, "waveform: failed to decode file %s\n", deadbeef->pl_find_meta (a->it, ":URI"));
+            deadbeef->pl_unlock ();
+            goto out;
+        }
+    }
+
+    const float duration = deadbeef->pl_get_item_duration (a->it);
+    const int channels = raw ? pcm.channels : fileinfo->fmt.channels;
+    const int samplerate = raw ? pcm.samplerate : fileinfo->fmt.samplerate;
+    const int samplesize = channels * ((raw ? pcm.bps : fileinfo->fmt.bps) / 8);
+    if (duration <= 0 || channels <= 0 || channels > MAX_CHANNELS || samplesize <= 0 || a->num_columns <= 0) {
+        goto out;
+    }
+    if ((size_t)a->num_columns * channels * VALUES_PER_SAMPLE > a->data_size) {
+        goto out;
+    }
+
+    a->channels = channels;
+    a->samplerate = samplerate;
+    a->total_frames = (int64_t)((double)duration * samplerate);
+
+    buffer = malloc (ANALYSIS_READ_FRAMES * samplesize);
+    data = malloc (sizeof (float) * ANALYSIS_READ_FRAMES * channels);
+    a->column_done = calloc (a->num_columns, 1);
+    if (a->features) {
+        waveform_meter_clear (a->features, a->num_columns);
+        meter = waveform_meter_new (channels, samplerate, a->meter_stages);
+    }
+    if (!buffer || !data || !a->column_done || (a->features && !meter)) {
+        trace ("waveform: out of memory.\n");
+        goto out;
+    }
+
+    ddb_waveformat_t out_fmt = {
+        .bps = 32,
+        .channels = channels,
+        .samplerate = samplerate,
+        .channelmask = raw ? 0 : fileinfo->fmt.channelmask,
+        .is_float = 1,
+        .is_bigendian = 0
+    };
+
+    memset (wavedata->data, 0, sizeof (short) * a->num_columns * channels * VALUES_PER_SAMPLE);
+    const int resumed = waveform_analysis_checkpoint_restore (a, dec, fileinfo, raw ? &pcm : NULL);
+    int estimated = 0;
+    if (!raw && !resumed && a->mp3_envelope) {
+        estimated = waveform_analysis_mp3_envelope (a, duration) == channels;
+        if (!estimated) {
+            memset (wavedata->data, 0, sizeof (short) * a->data_size);
+        }
+    }
+    if (!raw && !estimated && a->preview_decoders && waveform_analysis_decoder_listed (dec->plugin.id, a->preview_decoders)) {
+        if (waveform_analysis_preview (a, dec, fileinfo, buffer, data, &out_fmt)) {
+            a->position = -1;
+        }
+    }
+    if (a->progress) {
+        a->progress (a, 0, a->num_columns, a->user_data);
+    }
+    waveform_analysis_readahead_open (a, raw ? &pcm : NULL, &readahead);
+
+    // Columns are analyzed in chunks. Before each chunk the focus (usually
+    // the play position) is polled and work continues at the first unfinished
+    // column from there on, so a seek gets its part of the track done first.
+    pipeline.a = a;
+    pipeline.dec = dec;
+    pipeline.fileinfo = fileinfo;
+    pipeline.pcm = raw ? &pcm : NULL;
+    pipeline.out_fmt = &out_fmt;
+    pipeline.buffer = buffer;
+    pipeline.samplesize = samplesize;
+    if (waveform_analysis_pipe_start (&pipeline) != 0) {
+        trace ("waveform: failed to start decoder thread. (%s)\n", a->key);
+        goto out;
+    }
+
+    double checkpoint_time = waveform_analysis_time ();
+    double progress_time = checkpoint_time;
+    int dirty_first = a->num_columns;
+    int dirty_last = 0;
+    int eof_column = a->num_columns;
+    int cursor = 0;
+    int use_focus = raw || dec->seek || dec->seek_sample;
+    unsigned tap_seen = 0;
+    for (;;) {
+        const int64_t focus_frame = use_focus ? waveform_analysis_focus_frame (a) : -1;
+        const int focus = focus_frame >= 0 ? waveform_analysis_frame_column (a, focus_frame) : -1;
+        int column;
+        int limit = a->num_columns;
+        if (a->playback_tap && focus >= 0) {
+            // take what was played and only decode the parts that were skipped
+            a->columns_done += waveform_tap_collect (a->it, a->num_columns, channels, wavedata->data, a->column_done, &dirty_first, &dirty_last);
+            if (waveform_analysis_time () - progress_time >= ANALYSIS_PROGRESS_INTERVAL) {
+                waveform_analysis_publish (a, &dirty_first, &dirty_last);
+                progress_time = waveform_analysis_time ();
+            }
+            limit = waveform_analysis_tap_limit (a, focus_frame);
+            column = waveform_analysis_next_column (a, 0);
+            if (column >= limit) {
+                if (queue_is_cancelled (a->key)) {
+                    trace ("waveform: analysis cancelled. (%s)\n", a->key);
+                    waveform_analysis_checkpoint_save (a);
+                    goto out;
+                }
+                waveform_analysis_publish (a, &dirty_first, &dirty_last);
+                // the worker is handed to other jobs while the tap plays on
+                worker_pool_block (1);
+                if (waveform_tap_wait (a->it, waveform_analysis_tap_wake (a, column, focus_frame), &tap_seen) < 0) {
+                    a->playback_tap = 0;
+                }
+                worker_pool_block (0);
+                continue;
+            }
+        }
+        else {
+            column = waveform_analysis_next_column (a, focus >= 0 ? focus : cursor);
+        }
+        if (column < 0) {
+            break;
+        }
+        const int64_t chunk_start = waveform_analysis_column_start (a, column);
+        if (a->position != chunk_start) {
+            if (waveform_analysis_seek (dec, fileinfo, raw ? &pcm : NULL, chunk_start) != 0) {
+                if (focus >= 0 && a->position >= 0) {
+                    // carry on front to back from where the decoder is
+                    use_focus = 0;
+                    continue;
+                }
+                trace ("waveform: seek to column %d failed. (%s)\n", column, a->key);
+                goto out;
+            }
+            a->position = chunk_start;
+        }
+
+        // a chunk spans at least one full read, however narrow the columns
+        int chunk_end = column;
+        while (chunk_end < limit && !a->column_done[chunk_end]
+               && (chunk_end - column < ANALYSIS_CHUNK_COLUMNS
+                   || waveform_analysis_column_start (a, chunk_end) - chunk_start < ANALYSIS_READ_FRAMES)) {
+            chunk_end++;
+        }
+        if (queue_is_cancelled (a->key) || waveform_analysis_throttle (a) != 0) {
+            trace ("waveform: analysis cancelled. (%s)\n", a->key);
+            waveform_analysis_checkpoint_save (a);
+            goto out;
+        }
+
+        waveform_analysis_readahead (a, &readahead, raw ? &pcm : NULL, chunk_start, waveform_analysis_column_start (a, chunk_end));
+        waveform_analysis_pipe_request (&pipeline, column, chunk_end, a->position);
+        float max[MAX_CHANNELS];
+        float min[MAX_CHANNELS];
+        float sum[MAX_CHANNELS];
+        int64_t frames = 0;
+        int64_t column_end = waveform_analysis_column_end (a, column);
+        int cancelled = 0;
+        int eof = 0;
+        for (int ch = 0; ch < channels; ch++) {
+            max[ch] = -1.0;
+            min[ch] = 1.0;
+            sum[ch] = 0.0;
+        }
+        for (;;) {
+            analysis_block_t *block = waveform_analysis_pipe_next (&pipeline);
+            int offset = 0;
+            // accumulators carry over from one block to the next, a column is
+            // stored once its exact frame count has been seen
+            while (!cancelled && !eof && column < chunk_end) {
+                const int n = (int)MIN (block->frames - offset, column_end - a->position);
+                const float *block_data = block->data + offset * channels;
+                for (int ch = 0; ch < channels; ch++) {
+                    for (int sample = 0; sample < n; sample++) {
+                        const float sample_val = block_data[sample * channels + ch];
+                        max[ch] = MAX (max[ch], sample_val);
+                        min[ch] = MIN (min[ch], sample_val);
+                        sum[ch] += sample_val * sample_val;
+                    }
+                }
+                if (meter) {
+                    // the meter filters carry state, start afresh after a seek
+                    if (a->position != meter_position) {
+                        waveform_meter_reset (meter);
+                    }
+                    waveform_meter_process (meter, block_data, n);
+                    meter_position = a->position + n;
+                }
+                offset += n;
+                frames += n;
+                a->position += n;
+                if (a->position < column_end && !(block->eof && offset == block->frames)) {
+                    break;
+                }
+
+                waveform_analysis_store_column (a, column, max, min, sum, frames);
+                if (meter) {
+                    waveform_meter_store (meter, a->features + column * METER_VALUES);
+                }
+                a->column_done[column] = 1;
+                a->columns_done++;
+                dirty_first = MIN (dirty_first, column);
+                dirty_last = MAX (dirty_last, column + 1);
+                if (a->position < column_end) {
+                    // the track is shorter than its duration claimed, nothing
+                    // after this column can be decoded
+                    eof = 1;
+                    eof_column = MIN (eof_column, frames > 0 ? column + 1 : column);
+                    for (int c = column + 1; c < a->num_columns; c++) {
+                        if (!a->column_done[c]) {
+                            a->column_done[c] = 1;
+                            a->columns_done++;
+                        }
+                    }
+                    break;
+                }
+                frames = 0;
+                column++;
+                column_end = waveform_analysis_column_end (a, column);
+
+                if (waveform_analysis_time () - progress_time >= ANALYSIS_PROGRESS_INTERVAL) {
+                    waveform_analysis_publish (a, &dirty_first, &dirty_last);
+                    progress_time = waveform_analysis_time ();
+                }
+                if (a->checkpoints && waveform_analysis_time () - checkpoint_time >= ANALYSIS_CHECKPOINT_INTERVAL) {
+                    waveform_analysis_checkpoint_save (a);
+                    checkpoint_time = waveform_analysis_time ();
+                }
+                if (queue_is_cancelled (a->key)) {
+                    // let the decoder finish its block, then drain the ring
+                    cancelled = 1;
+                    __atomic_store_n (&pipeline.abort, 1, __ATOMIC_RELEASE);
+                }
+                else {
+                    worker_pool_yield (a->priority);
+                }
+            }
+            const int last = block->last;
+            waveform_analysis_pipe_release (&pipeline);
+            if (last) {
+                break;
+            }
+        }
+        if (cancelled) {
+            trace ("waveform: analysis cancelled. (%s)\n", a->key);
+            waveform_analysis_checkpoint_save (a);
+            goto out;
+        }
+        if (eof) {
+            a->position = -1;
+            cursor = a->num_columns;
+        }
+        else {
+            cursor = chunk_end;
+        }
+    }
+
+    memset (wavedata->data + eof_column * channels * VALUES_PER_SAMPLE,
+            0,
+            sizeof (short) * (a->num_columns - eof_column) * channels * VALUES_PER_SAMPLE);
+    if (a->features) {
+        waveform_meter_clear (a->features + eof_column * METER_VALUES, a->num_columns - eof_column);
+    }
+    a->columns_done = eof_column;
+    wavedata->data_len = a->columns_done * channels * VALUES_PER_SAMPLE;
+    wavedata->channels = channels;
+    if (a->checkpoints) {
+        waveform_db_checkpoint_delete (waveform_analysis_checkpoint_key (a));
+    }
+    result = 1;
+
+out:
+    waveform_analysis_pipe_stop (&pipeline);
+    waveform_readahead_close (&readahead);
+    if (buffer) {
+        free (buffer);
+        buffer = NULL;
+    }
+    if (data) {
+        free (data);
+        data = NULL;
+    }
+    if (meter) {
+        waveform_meter_free (meter);
+        meter = NULL;
+    }
+    if (a->column_done) {
+        free (a->column_done);
+        a->column_done = NULL;
+    }
+    if (dec && fileinfo) {
+        dec->free (fileinfo);
+        fileinfo = NULL;
+    }
+    waveform_pcm_close (&pcm);
+    return result;
+}
+
+int
+waveform_analysis_run (waveform_analysis_t *a)
+{
+    // jobs run inline by worker_pool_yield must not change the class of the
+    // job they interrupted
+    const int io_priority = a->idle_io ? waveform_throttle_io_priority (a->priority != JOB_PRIORITY_PLAYING) : -1;
+    const int result = waveform_analysis_decode (a);
+    waveform_throttle_io_restore (io_priority);
+    return result;
+}
+
+void
+waveform_analysis_slice (int64_t total_frames, int num_columns, int64_t start, int64_t end, int *first, int *count)
+{
+    *first = (int)CLAMP (start * num_columns / total_frames, 0, num_columns - 1);
+    const int64_t last = (end * num_columns + total_frames - 1) / total_frames;
+    *count = (int)MAX (1, MIN (last, num_columns) - *first);
+}
@@ -0,0 +1,105 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    Based on sndfile-tools waveform by Erik de Castro Lopo.
+        waveform.c - v1.04
+        Copyright (C) 2007-2012 Erik de Castro Lopo <erikd@mega-nerd.com>
+        Copyright (C) 2012 Robin Gareus <robin@gareus.org>
+        Copyright (C) 2013 driedfruit <driedfruit@mindloop.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef ANALYSIS_HEADER
+#define ANALYSIS_HEADER
+
+#include <stdint.h>
+
+#include <deadbeef/deadbeef.h>
+
+#include "waveform.h"
+
+typedef struct waveform_analysis_s waveform_analysis_t;
+
+// columns first to first + count - 1 changed since the last call
+typedef void (*waveform_analysis_progress_func) (waveform_analysis_t *a, int first, int count, void *user_data);
+// position in seconds the analysis should work outwards from, or < 0 for none
+typedef float (*waveform_analysis_focus_func) (waveform_analysis_t *a, void *user_data);
+
+struct waveform_analysis_s
+{
+    // set by the caller
+    DB_playItem_t *it;
+    // registry key, also used for checkpoints
+    const char *key;
+    int priority;
+    int num_columns;
+    // store and resume partial results in the cache, under checkpoint_key
+    // if set or key otherwise
+    int checkpoints;
+    const char *checkpoint_key;
+    // decoder ids that seek cheaply enough for a preview pass, NULL disables it
+    const char *preview_decoders;
+    waveform_analysis_progress_func progress;
+    // polled between chunks, NULL analyzes front to back
+    waveform_analysis_focus_func focus;
+    // take played columns from the playback tap and leave the part ahead of
+    // the focus to it, only decoding what playback skipped
+    int playback_tap;
+    // estimate local MP3 files from their frame side information, which
+    // stands in for the preview pass
+    int mp3_envelope;
+    // return the MP3 estimate without a full pass when there is one
+    int approximate_only;
+    // run I/O of jobs for other than the playing track at idle priority
+    int idle_io;
+    // pause between chunks while the load average per CPU is above max_load
+    // (not for the playing track) or less than min_buffer_ms of audio is
+    // buffered for playback, 0 disables either
+    float max_load;
+    int min_buffer_ms;
+    void *user_data;
+    // data must hold at least data_size values
+    wavedata_t *wavedata;
+    size_t data_size;
+    // num_columns * METER_VALUES meter values per column, NULL skips metering
+    short *features;
+    // METER_LEVELS and/or METER_BANDS
+    int meter_stages;
+
+    // filled in while running
+    int channels;
+    int samplerate;
+    // number of analyzed columns, which need not be contiguous
+    int columns_done;
+    // one flag per column
+    char *column_done;
+    int64_t total_frames;
+    // decoder position in frames, -1 if unknown
+    int64_t position;
+    // set if the result is only the MP3 estimate
+    int approximate;
+};
+
+int
+waveform_analysis_run (waveform_analysis_t *a);
+
+// columns of an analysis of total_frames that cover frames start to end
+void
+waveform_analysis_slice (int64_t total_frames, int num_columns, int64_t start, int64_t end, int *first, int *count);
+
+#endif
@@ -46,6 +46,7 @@ void
 waveform_db_close ()
 {
     sqlite3_close(db);
+    db = NULL;
 }
 
 void
@@ -60,6 +61,51 @@ waveform_db_init (char const *fname)
         fprintf(stderr, "SQL error: %s\n", zErrMsg);
     }
     sqlite3_free(zErrMsg);
+    zErrMsg = 0;
+
+    // partial results of interrupted analyses
+    query = "CREATE TABLE IF NOT EXISTS checkpoint ( path TEXT PRIMARY KEY NOT NULL, channels INTEGER NOT NULL, columns INTEGER NOT NULL, done INTEGER NOT NULL, position INTEGER NOT NULL, data BLOB)";
+    rc = sqlite3_exec(db, query, NULL, 0, &zErrMsg);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "SQL error: %s\n", zErrMsg);
+    }
+    sqlite3_free(zErrMsg);
+    zErrMsg = 0;
+
+    // whole files that CUE subtracks are sliced from
+    query = "CREATE TABLE IF NOT EXISTS image ( path TEXT PRIMARY KEY NOT NULL, channels INTEGER NOT NULL, columns INTEGER NOT NULL, frames INTEGER NOT NULL, data BLOB)";
+    rc = sqlite3_exec(db, query, NULL, 0, &zErrMsg);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "SQL error: %s\n", zErrMsg);
+    }
+    sqlite3_free(zErrMsg);
+    zErrMsg = 0;
+
+    // wave entries that were only estimated and still need a full analysis
+    query = "CREATE TABLE IF NOT EXISTS approximate ( path TEXT PRIMARY KEY NOT NULL )";
+    rc = sqlite3_exec(db, query, NULL, 0, &zErrMsg);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "SQL error: %s\n", zErrMsg);
+    }
+    sqlite3_free(zErrMsg);
+    zErrMsg = 0;
+
+    // per column meter values (true peak, clips, short-term loudness)
+    query = "CREATE TABLE IF NOT EXISTS features ( path TEXT PRIMARY KEY NOT NULL, columns INTEGER NOT NULL, data BLOB )";
+    rc = sqlite3_exec(db, query, NULL, 0, &zErrMsg);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "SQL error: %s\n", zErrMsg);
+    }
+    sqlite3_free(zErrMsg);
+    zErrMsg = 0;
+
+    // files seen by the library indexer, done once their analysis finished
+    query = "CREATE TABLE IF NOT EXISTS library ( path TEXT PRIMARY KEY NOT NULL, mtime INTEGER NOT NULL, done INTEGER NOT NULL )";
+    rc = sqlite3_exec(db, query, NULL, 0, &zErrMsg);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "SQL error: %s\n", zErrMsg);
+    }
+    sqlite3_free(zErrMsg);
 }
 
 int
@@ -142,7 +188,7 @@ waveform_db_write (char const *fname, short *buffer, int buffer_len, int channel
     int rc;
     sqlite3_stmt* p = 0;
 
-    char* query = "INSERT INTO wave (path, channels, compression, data) VALUES (?, ?, ?, ?);";
+    char* query = "INSERT OR REPLACE INTO wave (path, channels, compression, data) VALUES (?, ?, ?, ?);";
     rc = sqlite3_prepare_v2 (db, query, strlen(query), &p, NULL);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "write_perpare: SQL error: %d\n", rc);
@@ -169,3 +215,406 @@ waveform_db_write (char const *fname, short *buffer, int buffer_len, int channel
     }
     sqlite3_finalize (p);
 }
+
+int
+waveform_db_checkpoint_read (char const *fname, short *buffer, int buffer_len, int *channels, int *columns, int *done, int64_t *position)
+{
+    int rc;
+    sqlite3_stmt* p = 0;
+
+    char* query = "SELECT channels, columns, done, position, data FROM checkpoint WHERE path = ?;";
+    rc = sqlite3_prepare_v2 (db, query, strlen(query), &p, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "checkpoint_read_perpare: SQL error: %d\n", rc);
+        return 0;
+    }
+    sqlite3_bind_text (p, 1, fname, -1, SQLITE_STATIC);
+    rc = sqlite3_step (p);
+    if (rc != SQLITE_ROW) {
+        if (rc != SQLITE_DONE) {
+            fprintf(stderr, "checkpoint_read_exec: SQL error: %d\n", rc);
+        }
+        sqlite3_finalize (p);
+        return 0;
+    }
+
+    *channels = sqlite3_column_int (p,0);
+    *columns = sqlite3_column_int (p,1);
+    *done = sqlite3_column_int (p,2);
+    *position = sqlite3_column_int64 (p,3);
+    const void *data = sqlite3_column_blob (p,4);
+
+    int bytes = sqlite3_column_bytes (p,4);
+    if (bytes > buffer_len * sizeof(short)) {
+        bytes = buffer_len * sizeof(short);
+    }
+    if (data) {
+        memcpy (buffer,data,bytes);
+    }
+
+    sqlite3_finalize (p);
+    return bytes / sizeof(short);
+}
+
+void
+waveform_db_checkpoint_write (char const *fname, short *buffer, int buffer_len, int channels, int columns, int done, int64_t position)
+{
+    int rc;
+    sqlite3_stmt* p = 0;
+
+    char* query = "INSERT OR REPLACE INTO checkpoint (path, channels, columns, done, position, data) VALUES (?, ?, ?, ?, ?, ?);";
+    rc = sqlite3_prepare_v2 (db, query, strlen(query), &p, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "checkpoint_write_perpare: SQL error: %d\n", rc);
+        return;
+    }
+    sqlite3_bind_text (p, 1, fname, -1, SQLITE_STATIC);
+    sqlite3_bind_int (p, 2, channels);
+    sqlite3_bind_int (p, 3, columns);
+    sqlite3_bind_int (p, 4, done);
+    sqlite3_bind_int64 (p, 5, position);
+    sqlite3_bind_blob (p, 6, buffer, buffer_len, SQLITE_STATIC);
+    rc = sqlite3_step (p);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "checkpoint_write_exec: SQL error: %d\n", rc);
+    }
+    sqlite3_finalize (p);
+}
+
+void
+waveform_db_checkpoint_delete (char const *fname)
+{
+    int rc;
+    sqlite3_stmt* p = 0;
+
+    char* query = "DELETE FROM checkpoint WHERE path = ?;";
+    rc = sqlite3_prepare_v2 (db, query, strlen(query), &p, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "checkpoint_delete_perpare: SQL error: %d\n", rc);
+        return;
+    }
+    sqlite3_bind_text (p, 1, fname, -1, SQLITE_STATIC);
+    rc = sqlite3_step (p);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "checkpoint_delete_exec: SQL error: %d\n", rc);
+    }
+    sqlite3_finalize (p);
+}
+
+int
+waveform_db_image_info (char const *fname, int *channels, int *columns, int64_t *frames)
+{
+    int rc;
+    sqlite3_stmt* p = 0;
+
+    char* query = "SELECT channels, columns, frames FROM image WHERE path = ?;";
+    rc = sqlite3_prepare_v2 (db, query, strlen(query), &p, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "image_info_perpare: SQL error: %d\n", rc);
+        return 0;
+    }
+    sqlite3_bind_text (p, 1, fname, -1, SQLITE_STATIC);
+    rc = sqlite3_step (p);
+    if (rc != SQLITE_ROW) {
+        if (rc != SQLITE_DONE) {
+            fprintf(stderr, "image_info_exec: SQL error: %d\n", rc);
+        }
+        sqlite3_finalize (p);
+        return 0;
+    }
+    *channels = sqlite3_column_int (p,0);
+    *columns = sqlite3_column_int (p,1);
+    *frames = sqlite3_column_int64 (p,2);
+    sqlite3_finalize (p);
+    return 1;
+}
+
+// offset and buffer_len count values, only the requested part of the blob
+// is read
+int
+waveform_db_image_read (char const *fname, int offset, short *buffer, int buffer_len)
+{
+    int rc;
+    sqlite3_stmt* p = 0;
+
+    char* query = "SELECT substr(data, ?, ?) FROM image WHERE path = ?;";
+    rc = sqlite3_prepare_v2 (db, query, strlen(query), &p, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "image_read_perpare: SQL error: %d\n", rc);
+        return 0;
+    }
+    sqlite3_bind_int (p, 1, offset * sizeof(short) + 1);
+    sqlite3_bind_int (p, 2, buffer_len * sizeof(short));
+    sqlite3_bind_text (p, 3, fname, -1, SQLITE_STATIC);
+    rc = sqlite3_step (p);
+    if (rc != SQLITE_ROW) {
+        if (rc != SQLITE_DONE) {
+            fprintf(stderr, "image_read_exec: SQL error: %d\n", rc);
+        }
+        sqlite3_finalize (p);
+        return 0;
+    }
+
+    const void *data = sqlite3_column_blob (p,0);
+    int bytes = sqlite3_column_bytes (p,0);
+    if (bytes > buffer_len * sizeof(short)) {
+        bytes = buffer_len * sizeof(short);
+    }
+    if (data) {
+        memcpy (buffer,data,bytes);
+    }
+
+    sqlite3_finalize (p);
+    return bytes / sizeof(short);
+}
+
+void
+waveform_db_image_write (char const *fname, short *buffer, int buffer_len, int channels, int columns, int64_t frames)
+{
+    int rc;
+    sqlite3_stmt* p = 0;
+
+    char* query = "INSERT OR REPLACE INTO image (path, channels, columns, frames, data) VALUES (?, ?, ?, ?, ?);";
+    rc = sqlite3_prepare_v2 (db, query, strlen(query), &p, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "image_write_perpare: SQL error: %d\n", rc);
+        return;
+    }
+    sqlite3_bind_text (p, 1, fname, -1, SQLITE_STATIC);
+    sqlite3_bind_int (p, 2, channels);
+    sqlite3_bind_int (p, 3, columns);
+    sqlite3_bind_int64 (p, 4, frames);
+    sqlite3_bind_blob (p, 5, buffer, buffer_len, SQLITE_STATIC);
+    rc = sqlite3_step (p);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "image_write_exec: SQL error: %d\n", rc);
+    }
+    sqlite3_finalize (p);
+}
+
+void
+waveform_db_image_delete (char const *fname)
+{
+    int rc;
+    sqlite3_stmt* p = 0;
+
+    char* query = "DELETE FROM image WHERE path = ?;";
+    rc = sqlite3_prepare_v2 (db, query, strlen(query), &p, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "image_delete_perpare: SQL error: %d\n", rc);
+        return;
+    }
+    sqlite3_bind_text (p, 1, fname, -1, SQLITE_STATIC);
+    rc = sqlite3_step (p);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "image_delete_exec: SQL error: %d\n", rc);
+    }
+    sqlite3_finalize (p);
+}
+
+int
+waveform_db_approximate (char const *fname)
+{
+    int rc;
+    sqlite3_stmt* p = 0;
+
+    char* query = "SELECT path FROM approximate WHERE path = ?;";
+    rc = sqlite3_prepare_v2 (db, query, strlen(query), &p, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "approximate_perpare: SQL error: %d\n", rc);
+        return 0;
+    }
+    sqlite3_bind_text (p, 1, fname, -1, SQLITE_STATIC);
+    rc = sqlite3_step (p);
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE) {
+        fprintf(stderr, "approximate_exec: SQL error: %d\n", rc);
+    }
+    sqlite3_finalize (p);
+    return rc == SQLITE_ROW;
+}
+
+void
+waveform_db_approximate_set (char const *fname, int approximate)
+{
+    int rc;
+    sqlite3_stmt* p = 0;
+
+    char* query = approximate ? "INSERT OR REPLACE INTO approximate (path) VALUES (?);" : "DELETE FROM approximate WHERE path = ?;";
+    rc = sqlite3_prepare_v2 (db, query, strlen(query), &p, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "approximate_set_perpare: SQL error: %d\n", rc);
+        return;
+    }
+    sqlite3_bind_text (p, 1, fname, -1, SQLITE_STATIC);
+    rc = sqlite3_step (p);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "approximate_set_exec: SQL error: %d\n", rc);
+    }
+    sqlite3_finalize (p);
+}
+
+int
+waveform_db_features_read (char const *fname, short *buffer, int buffer_len, int *columns)
+{
+    int rc;
+    sqlite3_stmt* p = 0;
+
+    char* query = "SELECT columns, data FROM features WHERE path = ?;";
+    rc = sqlite3_prepare_v2 (db, query, strlen(query), &p, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "features_read_perpare: SQL error: %d\n", rc);
+        return 0;
+    }
+    sqlite3_bind_text (p, 1, fname, -1, SQLITE_STATIC);
+    rc = sqlite3_step (p);
+    if (rc != SQLITE_ROW) {
+        if (rc != SQLITE_DONE) {
+            fprintf(stderr, "features_read_exec: SQL error: %d\n", rc);
+        }
+        sqlite3_finalize (p);
+        return 0;
+    }
+
+    *columns = sqlite3_column_int (p,0);
+    const void *data = sqlite3_column_blob (p,1);
+
+    int bytes = sqlite3_column_bytes (p,1);
+    if (bytes > buffer_len * sizeof(short)) {
+        bytes = buffer_len * sizeof(short);
+    }
+    if (data) {
+        memcpy (buffer,data,bytes);
+    }
+
+    sqlite3_finalize (p);
+    return bytes / sizeof(short);
+}
+
+void
+waveform_db_features_write (char const *fname, short *buffer, int buffer_len, int columns)
+{
+    int rc;
+    sqlite3_stmt* p = 0;
+
+    char* query = "INSERT OR REPLACE INTO features (path, columns, data) VALUES (?, ?, ?);";
+    rc = sqlite3_prepare_v2 (db, query, strlen(query), &p, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "features_write_perpare: SQL error: %d\n", rc);
+        return;
+    }
+    sqlite3_bind_text (p, 1, fname, -1, SQLITE_STATIC);
+    sqlite3_bind_int (p, 2, columns);
+    sqlite3_bind_blob (p, 3, buffer, buffer_len, SQLITE_STATIC);
+    rc = sqlite3_step (p);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "features_write_exec: SQL error: %d\n", rc);
+    }
+    sqlite3_finalize (p);
+}
+
+void
+waveform_db_features_delete (char const *fname)
+{
+    int rc;
+    sqlite3_stmt* p = 0;
+
+    char* query = "DELETE FROM features WHERE path = ?;";
+    rc = sqlite3_prepare_v2 (db, query, strlen(query), &p, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "features_delete_perpare: SQL error: %d\n", rc);
+        return;
+    }
+    sqlite3_bind_text (p, 1, fname, -1, SQLITE_STATIC);
+    rc = sqlite3_step (p);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "features_delete_exec: SQL error: %d\n", rc);
+    }
+    sqlite3_finalize (p);
+}
+
+int
+waveform_db_library_read (char const *fname, int64_t *mtime)
+{
+    int rc;
+    sqlite3_stmt* p = 0;
+
+    char* query = "SELECT mtime, done FROM library WHERE path = ?;";
+    rc = sqlite3_prepare_v2 (db, query, strlen(query), &p, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "library_read_perpare: SQL error: %d\n", rc);
+        return -1;
+    }
+    sqlite3_bind_text (p, 1, fname, -1, SQLITE_STATIC);
+    rc = sqlite3_step (p);
+    int done = -1;
+    if (rc == SQLITE_ROW) {
+        *mtime = sqlite3_column_int64 (p, 0);
+        done = sqlite3_column_int (p, 1);
+    }
+    else if (rc != SQLITE_DONE) {
+        fprintf(stderr, "library_read_exec: SQL error: %d\n", rc);
+    }
+    sqlite3_finalize (p);
+    return done;
+}
+
+void
+waveform_db_library_write (char const *fname, int64_t mtime)
+{
+    int rc;
+    sqlite3_stmt* p = 0;
+
+    char* query = "INSERT OR REPLACE INTO library (path, mtime, done) VALUES (?, ?, 0);";
+    rc = sqlite3_prepare_v2 (db, query, strlen(query), &p, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "library_write_perpare: SQL error: %d\n", rc);
+        return;
+    }
+    sqlite3_bind_text (p, 1, fname, -1, SQLITE_STATIC);
+    sqlite3_bind_int64 (p, 2, mtime);
+    rc = sqlite3_step (p);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "library_write_exec: SQL error: %d\n", rc);
+    }
+    sqlite3_finalize (p);
+}
+
+void
+waveform_db_library_done (char const *fname)
+{
+    int rc;
+    sqlite3_stmt* p = 0;
+
+    char* query = "UPDATE library SET done = 1 WHERE path = ?;";
+    rc = sqlite3_prepare_v2 (db, query, strlen(query), &p, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "library_done_perpare: SQL error: %d\n", rc);
+        return;
+    }
+    sqlite3_bind_text (p, 1, fname, -1, SQLITE_STATIC);
+    rc = sqlite3_step (p);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "library_done_exec: SQL error: %d\n", rc);
+    }
+    sqlite3_finalize (p);
+}
+
+void
+waveform_db_library_delete (char const *fname)
+{
+    int rc;
+    sqlite3_stmt* p = 0;
+
+    char* query = "DELETE FROM library WHERE path = ?;";
+    rc = sqlite3_prepare_v2 (db, query, strlen(query), &p, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "library_delete_perpare: SQL error: %d\n", rc);
+        return;
+    }
+    sqlite3_bind_text (p, 1, fname, -1, SQLITE_STATIC);
+    rc = sqlite3_step (p);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "library_delete_exec: SQL error: %d\n", rc);
+    }
+    sqlite3_finalize (p);
+}
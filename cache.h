@@ -31,6 +31,7 @@
 #include <assert.h>
 #include <math.h>
 #include <fcntl.h>
+#include <stdint.h>
 #include <sqlite3.h>
 
 void
@@ -53,3 +54,55 @@ waveform_db_read (char const *fname, short *buffer, int buffer_len, int *channel
 
 void
 waveform_db_write (char const *fname, short *buffer, int buffer_len, int channels, int compression);
+
+int
+waveform_db_checkpoint_read (char const *fname, short *buffer, int buffer_len, int *channels, int *columns, int *done, int64_t *position);
+
+void
+waveform_db_checkpoint_write (char const *fname, short *buffer, int buffer_len, int channels, int columns, int done, int64_t position);
+
+void
+waveform_db_checkpoint_delete (char const *fname);
+
+int
+waveform_db_image_info (char const *fname, int *channels, int *columns, int64_t *frames);
+
+int
+waveform_db_image_read (char const *fname, int offset, short *buffer, int buffer_len);
+
+void
+waveform_db_image_write (char const *fname, short *buffer, int buffer_len, int channels, int columns, int64_t frames);
+
+void
+waveform_db_image_delete (char const *fname);
+
+// whether the wave entry of fname is only an estimate
+int
+waveform_db_approximate (char const *fname);
+
+void
+waveform_db_approximate_set (char const *fname, int approximate);
+
+// Meter values, METER_VALUES per column. Returns the number of values read.
+int
+waveform_db_features_read (char const *fname, short *buffer, int buffer_len, int *columns);
+
+void
+waveform_db_features_write (char const *fname, short *buffer, int buffer_len, int columns);
+
+void
+waveform_db_features_delete (char const *fname);
+
+// Library indexer records. Returns -1 if fname was never seen, otherwise
+// whether its analysis finished and the mtime it was queued with.
+int
+waveform_db_library_read (char const *fname, int64_t *mtime);
+
+void
+waveform_db_library_write (char const *fname, int64_t mtime);
+
+void
+waveform_db_library_done (char const *fname);
+
+void
+waveform_db_library_delete (char const *fname);
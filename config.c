@@ -40,6 +40,7 @@
 
 gboolean CONFIG_LOG_ENABLED = FALSE;
 gboolean CONFIG_MIX_TO_MONO = FALSE;
+gboolean CONFIG_MID_SIDE = FALSE;
 gboolean CONFIG_CACHE_ENABLED = TRUE;
 gboolean CONFIG_SCROLL_ENABLED = TRUE;
 gboolean CONFIG_DISPLAY_RMS = TRUE;
@@ -63,6 +64,30 @@ gint     CONFIG_CURSOR_WIDTH = 3;
 gint     CONFIG_FONT_SIZE = 18;
 gint     CONFIG_MAX_FILE_LENGTH = 180;
 gint     CONFIG_NUM_SAMPLES = 2048;
+gint     CONFIG_NUM_WORKERS = 2;
+gint     CONFIG_DECODE_DELAY = 300;
+gboolean CONFIG_PREVIEW_ENABLED = TRUE;
+char     CONFIG_PREVIEW_DECODERS[256] = CONFIG_PREVIEW_DECODERS_DEFAULT;
+gboolean CONFIG_PLAYBACK_TAP = FALSE;
+gboolean CONFIG_MP3_ENVELOPE = FALSE;
+gboolean CONFIG_IDLE_IO = TRUE;
+gint     CONFIG_MAX_LOAD = 150;
+gint     CONFIG_MIN_BUFFER = 500;
+gboolean CONFIG_INDEX_ENABLED = FALSE;
+char     CONFIG_INDEX_ROOTS[1024] = "";
+gboolean CONFIG_PRELOAD_ADDED = FALSE;
+gboolean CONFIG_PREFETCH_NEXT = TRUE;
+gint     CONFIG_BATCH_READERS = 2;
+gboolean CONFIG_BATCH_LOCALITY = TRUE;
+gboolean CONFIG_REMOTE_ENABLED = FALSE;
+gint     CONFIG_REMOTE_RATE = 512;
+gint     CONFIG_REMOTE_MAX_SIZE = 512;
+gboolean CONFIG_METERS_ENABLED = FALSE;
+gboolean CONFIG_SHOW_CLIPS = TRUE;
+gboolean CONFIG_SHOW_LOUDNESS = FALSE;
+gboolean CONFIG_BAND_COLORS = FALSE;
+gboolean CONFIG_STREAM_ENABLED = TRUE;
+gint     CONFIG_STREAM_WINDOW = 5;
 gint     CONFIG_REFRESH_INTERVAL = 33;
 
 void
@@ -70,6 +95,7 @@ save_config (void)
 {
     deadbeef->conf_set_int (CONFSTR_WF_LOG_ENABLED,         CONFIG_LOG_ENABLED);
     deadbeef->conf_set_int (CONFSTR_WF_MIX_TO_MONO,         CONFIG_MIX_TO_MONO);
+    deadbeef->conf_set_int (CONFSTR_WF_MID_SIDE,            CONFIG_MID_SIDE);
     deadbeef->conf_set_int (CONFSTR_WF_DISPLAY_RMS,         CONFIG_DISPLAY_RMS);
     deadbeef->conf_set_int (CONFSTR_WF_DISPLAY_RULER,       CONFIG_DISPLAY_RULER);
     deadbeef->conf_set_int (CONFSTR_WF_SHADE_WAVEFORM,      CONFIG_SHADE_WAVEFORM);
@@ -82,6 +108,30 @@ save_config (void)
     deadbeef->conf_set_int (CONFSTR_WF_MAX_FILE_LENGTH,     CONFIG_MAX_FILE_LENGTH);
     deadbeef->conf_set_int (CONFSTR_WF_REFRESH_INTERVAL,    CONFIG_REFRESH_INTERVAL);
     deadbeef->conf_set_int (CONFSTR_WF_NUM_SAMPLES,         CONFIG_NUM_SAMPLES);
+    deadbeef->conf_set_int (CONFSTR_WF_NUM_WORKERS,         CONFIG_NUM_WORKERS);
+    deadbeef->conf_set_int (CONFSTR_WF_DECODE_DELAY,        CONFIG_DECODE_DELAY);
+    deadbeef->conf_set_int (CONFSTR_WF_PREVIEW_ENABLED,     CONFIG_PREVIEW_ENABLED);
+    deadbeef->conf_set_str (CONFSTR_WF_PREVIEW_DECODERS,    CONFIG_PREVIEW_DECODERS);
+    deadbeef->conf_set_int (CONFSTR_WF_PLAYBACK_TAP,        CONFIG_PLAYBACK_TAP);
+    deadbeef->conf_set_int (CONFSTR_WF_MP3_ENVELOPE,        CONFIG_MP3_ENVELOPE);
+    deadbeef->conf_set_int (CONFSTR_WF_IDLE_IO,             CONFIG_IDLE_IO);
+    deadbeef->conf_set_int (CONFSTR_WF_MAX_LOAD,            CONFIG_MAX_LOAD);
+    deadbeef->conf_set_int (CONFSTR_WF_MIN_BUFFER,          CONFIG_MIN_BUFFER);
+    deadbeef->conf_set_int (CONFSTR_WF_INDEX_ENABLED,       CONFIG_INDEX_ENABLED);
+    deadbeef->conf_set_str (CONFSTR_WF_INDEX_ROOTS,         CONFIG_INDEX_ROOTS);
+    deadbeef->conf_set_int (CONFSTR_WF_PRELOAD_ADDED,       CONFIG_PRELOAD_ADDED);
+    deadbeef->conf_set_int (CONFSTR_WF_PREFETCH_NEXT,       CONFIG_PREFETCH_NEXT);
+    deadbeef->conf_set_int (CONFSTR_WF_BATCH_READERS,       CONFIG_BATCH_READERS);
+    deadbeef->conf_set_int (CONFSTR_WF_BATCH_LOCALITY,      CONFIG_BATCH_LOCALITY);
+    deadbeef->conf_set_int (CONFSTR_WF_REMOTE_ENABLED,      CONFIG_REMOTE_ENABLED);
+    deadbeef->conf_set_int (CONFSTR_WF_REMOTE_RATE,         CONFIG_REMOTE_RATE);
+    deadbeef->conf_set_int (CONFSTR_WF_REMOTE_MAX_SIZE,     CONFIG_REMOTE_MAX_SIZE);
+    deadbeef->conf_set_int (CONFSTR_WF_METERS_ENABLED,      CONFIG_METERS_ENABLED);
+    deadbeef->conf_set_int (CONFSTR_WF_SHOW_CLIPS,          CONFIG_SHOW_CLIPS);
+    deadbeef->conf_set_int (CONFSTR_WF_SHOW_LOUDNESS,       CONFIG_SHOW_LOUDNESS);
+    deadbeef->conf_set_int (CONFSTR_WF_BAND_COLORS,         CONFIG_BAND_COLORS);
+    deadbeef->conf_set_int (CONFSTR_WF_STREAM_ENABLED,      CONFIG_STREAM_ENABLED);
+    deadbeef->conf_set_int (CONFSTR_WF_STREAM_WINDOW,       CONFIG_STREAM_WINDOW);
     deadbeef->conf_set_int (CONFSTR_WF_CACHE_ENABLED,       CONFIG_CACHE_ENABLED);
     deadbeef->conf_set_int (CONFSTR_WF_SCROLL_ENABLED,      CONFIG_SCROLL_ENABLED);
     deadbeef->conf_set_int (CONFSTR_WF_BG_COLOR_R,          CONFIG_BG_COLOR.red);
@@ -112,6 +162,7 @@ load_config (void)
     deadbeef->conf_lock ();
     CONFIG_LOG_ENABLED = deadbeef->conf_get_int (CONFSTR_WF_LOG_ENABLED,             FALSE);
     CONFIG_MIX_TO_MONO = deadbeef->conf_get_int (CONFSTR_WF_MIX_TO_MONO,             FALSE);
+    CONFIG_MID_SIDE = deadbeef->conf_get_int (CONFSTR_WF_MID_SIDE,                   FALSE);
     CONFIG_DISPLAY_RMS = deadbeef->conf_get_int (CONFSTR_WF_DISPLAY_RMS,              TRUE);
     CONFIG_DISPLAY_RULER = deadbeef->conf_get_int (CONFSTR_WF_DISPLAY_RULER,         FALSE);
     CONFIG_SHADE_WAVEFORM = deadbeef->conf_get_int (CONFSTR_WF_SHADE_WAVEFORM,       FALSE);
@@ -124,6 +175,31 @@ load_config (void)
     CONFIG_REFRESH_INTERVAL = deadbeef->conf_get_int (CONFSTR_WF_REFRESH_INTERVAL,      33);
     CONFIG_MAX_FILE_LENGTH = deadbeef->conf_get_int (CONFSTR_WF_MAX_FILE_LENGTH,       180);
     CONFIG_NUM_SAMPLES = deadbeef->conf_get_int (CONFSTR_WF_NUM_SAMPLES,              2048);
+    CONFIG_NUM_WORKERS = deadbeef->conf_get_int (CONFSTR_WF_NUM_WORKERS,                 2);
+    CONFIG_DECODE_DELAY = deadbeef->conf_get_int (CONFSTR_WF_DECODE_DELAY,             300);
+    CONFIG_PREVIEW_ENABLED = deadbeef->conf_get_int (CONFSTR_WF_PREVIEW_ENABLED,      TRUE);
+    deadbeef->conf_get_str (CONFSTR_WF_PREVIEW_DECODERS, CONFIG_PREVIEW_DECODERS_DEFAULT,
+                            CONFIG_PREVIEW_DECODERS, sizeof (CONFIG_PREVIEW_DECODERS));
+    CONFIG_PLAYBACK_TAP = deadbeef->conf_get_int (CONFSTR_WF_PLAYBACK_TAP,            FALSE);
+    CONFIG_MP3_ENVELOPE = deadbeef->conf_get_int (CONFSTR_WF_MP3_ENVELOPE,            FALSE);
+    CONFIG_IDLE_IO = deadbeef->conf_get_int (CONFSTR_WF_IDLE_IO,                      TRUE);
+    CONFIG_MAX_LOAD = deadbeef->conf_get_int (CONFSTR_WF_MAX_LOAD,                     150);
+    CONFIG_MIN_BUFFER = deadbeef->conf_get_int (CONFSTR_WF_MIN_BUFFER,                 500);
+    CONFIG_INDEX_ENABLED = deadbeef->conf_get_int (CONFSTR_WF_INDEX_ENABLED,          FALSE);
+    deadbeef->conf_get_str (CONFSTR_WF_INDEX_ROOTS, "", CONFIG_INDEX_ROOTS, sizeof (CONFIG_INDEX_ROOTS));
+    CONFIG_PRELOAD_ADDED = deadbeef->conf_get_int (CONFSTR_WF_PRELOAD_ADDED,          FALSE);
+    CONFIG_PREFETCH_NEXT = deadbeef->conf_get_int (CONFSTR_WF_PREFETCH_NEXT,           TRUE);
+    CONFIG_BATCH_READERS = deadbeef->conf_get_int (CONFSTR_WF_BATCH_READERS,              2);
+    CONFIG_BATCH_LOCALITY = deadbeef->conf_get_int (CONFSTR_WF_BATCH_LOCALITY,         TRUE);
+    CONFIG_REMOTE_ENABLED = deadbeef->conf_get_int (CONFSTR_WF_REMOTE_ENABLED,        FALSE);
+    CONFIG_REMOTE_RATE = deadbeef->conf_get_int (CONFSTR_WF_REMOTE_RATE,                512);
+    CONFIG_REMOTE_MAX_SIZE = deadbeef->conf_get_int (CONFSTR_WF_REMOTE_MAX_SIZE,        512);
+    CONFIG_METERS_ENABLED = deadbeef->conf_get_int (CONFSTR_WF_METERS_ENABLED,        FALSE);
+    CONFIG_SHOW_CLIPS = deadbeef->conf_get_int (CONFSTR_WF_SHOW_CLIPS,                TRUE);
+    CONFIG_SHOW_LOUDNESS = deadbeef->conf_get_int (CONFSTR_WF_SHOW_LOUDNESS,          FALSE);
+    CONFIG_BAND_COLORS = deadbeef->conf_get_int (CONFSTR_WF_BAND_COLORS,              FALSE);
+    CONFIG_STREAM_ENABLED = deadbeef->conf_get_int (CONFSTR_WF_STREAM_ENABLED,        TRUE);
+    CONFIG_STREAM_WINDOW = deadbeef->conf_get_int (CONFSTR_WF_STREAM_WINDOW,          5);
     CONFIG_CACHE_ENABLED = deadbeef->conf_get_int (CONFSTR_WF_CACHE_ENABLED,          TRUE);
     CONFIG_SCROLL_ENABLED = deadbeef->conf_get_int (CONFSTR_WF_SCROLL_ENABLED,        TRUE);
 
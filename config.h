@@ -40,6 +40,7 @@
 
 #define     CONFSTR_WF_LOG_ENABLED       "waveform.log_enabled"
 #define     CONFSTR_WF_MIX_TO_MONO       "waveform.mix_to_mono"
+#define     CONFSTR_WF_MID_SIDE          "waveform.mid_side"
 #define     CONFSTR_WF_DISPLAY_RMS       "waveform.display_rms"
 #define     CONFSTR_WF_DISPLAY_RULER     "waveform.display_ruler"
 #define     CONFSTR_WF_RENDER_METHOD     "waveform.render_method"
@@ -75,9 +76,36 @@
 #define     CONFSTR_WF_CACHE_ENABLED     "waveform.cache_enabled"
 #define     CONFSTR_WF_SCROLL_ENABLED    "waveform.scroll_enabled"
 #define     CONFSTR_WF_NUM_SAMPLES       "waveform.num_samples"
+#define     CONFSTR_WF_NUM_WORKERS       "waveform.num_workers"
+#define     CONFSTR_WF_DECODE_DELAY      "waveform.decode_delay"
+#define     CONFSTR_WF_PREVIEW_ENABLED   "waveform.preview_enabled"
+#define     CONFSTR_WF_PREVIEW_DECODERS  "waveform.preview_decoders"
+#define     CONFSTR_WF_PLAYBACK_TAP      "waveform.playback_tap"
+#define     CONFSTR_WF_MP3_ENVELOPE      "waveform.mp3_envelope"
+#define     CONFSTR_WF_IDLE_IO           "waveform.idle_io"
+#define     CONFSTR_WF_MAX_LOAD          "waveform.max_load"
+#define     CONFSTR_WF_MIN_BUFFER        "waveform.min_buffer"
+#define     CONFSTR_WF_INDEX_ENABLED     "waveform.index_enabled"
+#define     CONFSTR_WF_INDEX_ROOTS       "waveform.index_roots"
+#define     CONFSTR_WF_PRELOAD_ADDED     "waveform.preload_added"
+#define     CONFSTR_WF_PREFETCH_NEXT     "waveform.prefetch_next"
+#define     CONFSTR_WF_BATCH_READERS     "waveform.batch_readers"
+#define     CONFSTR_WF_BATCH_LOCALITY    "waveform.batch_locality"
+#define     CONFSTR_WF_REMOTE_ENABLED    "waveform.remote_enabled"
+#define     CONFSTR_WF_REMOTE_RATE       "waveform.remote_rate"
+#define     CONFSTR_WF_REMOTE_MAX_SIZE   "waveform.remote_max_size"
+#define     CONFSTR_WF_METERS_ENABLED    "waveform.meters_enabled"
+#define     CONFSTR_WF_SHOW_CLIPS        "waveform.show_clips"
+#define     CONFSTR_WF_SHOW_LOUDNESS     "waveform.show_loudness"
+#define     CONFSTR_WF_BAND_COLORS       "waveform.band_colors"
+#define     CONFSTR_WF_STREAM_ENABLED    "waveform.stream_enabled"
+#define     CONFSTR_WF_STREAM_WINDOW     "waveform.stream_window"
+
+#define     CONFIG_PREVIEW_DECODERS_DEFAULT "stdflac sndfile wv ffap tta alac"
 
 extern gboolean CONFIG_LOG_ENABLED;
 extern gboolean CONFIG_MIX_TO_MONO;
+extern gboolean CONFIG_MID_SIDE;
 extern gboolean CONFIG_CACHE_ENABLED;
 extern gboolean CONFIG_SCROLL_ENABLED;
 extern gboolean CONFIG_DISPLAY_RMS;
@@ -101,6 +129,30 @@ extern gint     CONFIG_CURSOR_WIDTH;
 extern gint     CONFIG_FONT_SIZE;
 extern gint     CONFIG_MAX_FILE_LENGTH;
 extern gint     CONFIG_NUM_SAMPLES;
+extern gint     CONFIG_NUM_WORKERS;
+extern gint     CONFIG_DECODE_DELAY;
+extern gboolean CONFIG_PREVIEW_ENABLED;
+extern char     CONFIG_PREVIEW_DECODERS[256];
+extern gboolean CONFIG_PLAYBACK_TAP;
+extern gboolean CONFIG_MP3_ENVELOPE;
+extern gboolean CONFIG_IDLE_IO;
+extern gint     CONFIG_MAX_LOAD;
+extern gint     CONFIG_MIN_BUFFER;
+extern gboolean CONFIG_INDEX_ENABLED;
+extern char     CONFIG_INDEX_ROOTS[1024];
+extern gboolean CONFIG_PRELOAD_ADDED;
+extern gboolean CONFIG_PREFETCH_NEXT;
+extern gint     CONFIG_BATCH_READERS;
+extern gboolean CONFIG_BATCH_LOCALITY;
+extern gboolean CONFIG_REMOTE_ENABLED;
+extern gint     CONFIG_REMOTE_RATE;
+extern gint     CONFIG_REMOTE_MAX_SIZE;
+extern gboolean CONFIG_METERS_ENABLED;
+extern gboolean CONFIG_SHOW_CLIPS;
+extern gboolean CONFIG_SHOW_LOUDNESS;
+extern gboolean CONFIG_BAND_COLORS;
+extern gboolean CONFIG_STREAM_ENABLED;
+extern gint     CONFIG_STREAM_WINDOW;
 extern gint     CONFIG_REFRESH_INTERVAL;
 
 
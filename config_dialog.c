@@ -58,6 +58,7 @@ on_button_config (GtkMenuItem *menuitem, gpointer user_data)
     GtkWidget *progressbar_color;
     GtkWidget *ruler_color;
     GtkWidget *downmix_to_mono;
+    GtkWidget *mid_side;
     GtkWidget *log_scale;
     GtkWidget *display_rms;
     GtkWidget *display_ruler;
@@ -214,6 +215,10 @@ on_button_config (GtkMenuItem *menuitem, gpointer user_data)
     gtk_widget_show (downmix_to_mono);
     gtk_box_pack_start (GTK_BOX (vbox03), downmix_to_mono, FALSE, FALSE, 0);
 
+    mid_side = gtk_check_button_new_with_label ("Mid/side");
+    gtk_widget_show (mid_side);
+    gtk_box_pack_start (GTK_BOX (vbox03), mid_side, FALSE, FALSE, 0);
+
     log_scale = gtk_check_button_new_with_label ("Logarithmic scale");
     gtk_widget_show (log_scale);
     gtk_box_pack_start (GTK_BOX (vbox03), log_scale, FALSE, FALSE, 0);
@@ -257,6 +262,7 @@ on_button_config (GtkMenuItem *menuitem, gpointer user_data)
     gtk_color_button_set_alpha (GTK_COLOR_BUTTON (foreground_rms_color), CONFIG_FG_RMS_ALPHA);
 
     gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (downmix_to_mono), CONFIG_MIX_TO_MONO);
+    gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (mid_side), CONFIG_MID_SIDE);
     gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (log_scale), CONFIG_LOG_ENABLED);
     gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (display_rms), CONFIG_DISPLAY_RMS);
     gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (display_ruler), CONFIG_DISPLAY_RULER);
@@ -289,6 +295,7 @@ on_button_config (GtkMenuItem *menuitem, gpointer user_data)
             CONFIG_RLR_ALPHA = gtk_color_button_get_alpha (GTK_COLOR_BUTTON (ruler_color));
             CONFIG_FG_RMS_ALPHA = gtk_color_button_get_alpha (GTK_COLOR_BUTTON (foreground_rms_color));
             CONFIG_MIX_TO_MONO = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (downmix_to_mono));
+            CONFIG_MID_SIDE = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (mid_side));
             CONFIG_LOG_ENABLED = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (log_scale));
             CONFIG_DISPLAY_RMS = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (display_rms));
             CONFIG_DISPLAY_RULER = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (display_ruler));
@@ -0,0 +1,363 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    Based on sndfile-tools waveform by Erik de Castro Lopo.
+        waveform.c - v1.04
+        Copyright (C) 2007-2012 Erik de Castro Lopo <erikd@mega-nerd.com>
+        Copyright (C) 2012 Robin Gareus <robin@gareus.org>
+        Copyright (C) 2013 driedfruit <driedfruit@mindloop.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include <deadbeef/deadbeef.h>
+
+#include "index.h"
+#include "cache.h"
+#include "throttle.h"
+#include "utils.h"
+#include "waveform.h"
+
+#ifdef __linux__
+
+// files queued by the indexer wait until fewer jobs than this are pending
+#define INDEX_MAX_PENDING (32)
+// milliseconds between two looks at the stop flag
+#define INDEX_POLL_TIMEOUT (500)
+#define INDEX_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE)
+
+typedef struct
+{
+    int wd;
+    char *path;
+} index_watch_t;
+
+static intptr_t tid;
+static int stopping;
+static char *roots;
+static waveform_index_queue_func queue_func;
+static int inotify_fd = -1;
+static index_watch_t *watches;
+static int num_watches;
+
+static int
+waveform_index_stopping (void)
+{
+    return __atomic_load_n (&stopping, __ATOMIC_ACQUIRE);
+}
+
+static int
+waveform_index_supported (const char *name)
+{
+    const char *ext = strrchr (name, '.');
+    if (!ext || ext == name) {
+        return 0;
+    }
+    ext++;
+    DB_decoder_t **decoders = deadbeef->plug_get_decoder_list ();
+    for (int i = 0; decoders && decoders[i]; i++) {
+        const char **exts = decoders[i]->exts;
+        for (int e = 0; exts && exts[e]; e++) {
+            if (!strcasecmp (exts[e], ext)) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static char *
+waveform_index_join (const char *dir, const char *name)
+{
+    const size_t len = strlen (dir) + strlen (name) + 2;
+    char *path = malloc (len);
+    if (path) {
+        snprintf (path, len, "%s/%s", dir, name);
+    }
+    return path;
+}
+
+// Loads the tracks of path into a playlist of its own, which is never shown,
+// and queues them. Jobs keep their own reference to the tracks.
+static void
+waveform_index_file (const char *path)
+{
+    struct stat st;
+    if (stat (path, &st) != 0 || !S_ISREG (st.st_mode) || !waveform_index_supported (path)) {
+        return;
+    }
+    int64_t mtime = 0;
+    const int done = waveform_db_library_read (path, &mtime);
+    if (done == 1 && mtime == (int64_t)st.st_mtime) {
+        return;
+    }
+    const int changed = done >= 0 && mtime != (int64_t)st.st_mtime;
+
+    while (queue_pending () >= INDEX_MAX_PENDING && !waveform_index_stopping ()) {
+        usleep (INDEX_POLL_TIMEOUT * 1000);
+    }
+    if (waveform_index_stopping ()) {
+        return;
+    }
+
+    waveform_db_library_write (path, (int64_t)st.st_mtime);
+    ddb_playlist_t *plt = deadbeef->plt_alloc ("waveform library");
+    if (!plt) {
+        return;
+    }
+    int abort = 0;
+    deadbeef->plt_insert_file2 (0, plt, NULL, path, &abort, NULL, NULL);
+    int queued = 0;
+    DB_playItem_t *it = deadbeef->plt_get_first (plt, PL_MAIN);
+    while (it) {
+        queued += queue_func (it, changed) ? 1 : 0;
+        DB_playItem_t *next = deadbeef->pl_get_next (it, PL_MAIN);
+        deadbeef->pl_item_unref (it);
+        it = next;
+    }
+    deadbeef->plt_unref (plt);
+    if (!queued) {
+        // nothing to analyze, or it is already queued from elsewhere
+        waveform_db_library_done (path);
+    }
+    trace ("waveform: indexed %s, %d tracks queued\n", path, queued);
+}
+
+static void
+waveform_index_watch (const char *path)
+{
+    const int wd = inotify_add_watch (inotify_fd, path, INDEX_EVENTS | IN_ONLYDIR);
+    if (wd < 0) {
+        fprintf (stderr, "waveform: cannot watch %s\n", path);
+        return;
+    }
+    for (int i = 0; i < num_watches; i++) {
+        if (watches[i].wd == wd) {
+            return;
+        }
+    }
+    index_watch_t *grown = realloc (watches, (num_watches + 1) * sizeof (index_watch_t));
+    char *copy = strdup (path);
+    if (!grown || !copy) {
+        free (copy);
+        if (grown) {
+            watches = grown;
+        }
+        return;
+    }
+    watches = grown;
+    watches[num_watches].wd = wd;
+    watches[num_watches].path = copy;
+    num_watches++;
+}
+
+static const char *
+waveform_index_watch_path (int wd)
+{
+    for (int i = 0; i < num_watches; i++) {
+        if (watches[i].wd == wd) {
+            return watches[i].path;
+        }
+    }
+    return NULL;
+}
+
+static void
+waveform_index_unwatch (int wd)
+{
+    for (int i = 0; i < num_watches; i++) {
+        if (watches[i].wd == wd) {
+            free (watches[i].path);
+            watches[i] = watches[--num_watches];
+            return;
+        }
+    }
+}
+
+// Symlinked directories are not followed, they could form loops.
+static void
+waveform_index_scan (const char *dir)
+{
+    // watch first, so nothing added during the scan is missed
+    waveform_index_watch (dir);
+    DIR *d = opendir (dir);
+    if (!d) {
+        return;
+    }
+    struct dirent *entry;
+    while (!waveform_index_stopping () && (entry = readdir (d))) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        char *path = waveform_index_join (dir, entry->d_name);
+        struct stat st;
+        if (path && lstat (path, &st) == 0) {
+            if (S_ISDIR (st.st_mode)) {
+                waveform_index_scan (path);
+            }
+            else {
+                waveform_index_file (path);
+            }
+        }
+        free (path);
+    }
+    closedir (d);
+}
+
+static void
+waveform_index_scan_roots (void)
+{
+    char *list = strdup (roots);
+    if (!list) {
+        return;
+    }
+    char *save = NULL;
+    for (char *root = strtok_r (list, ";", &save); root && !waveform_index_stopping (); root = strtok_r (NULL, ";", &save)) {
+        while (*root == ' ') {
+            root++;
+        }
+        if (*root) {
+            waveform_index_scan (root);
+        }
+    }
+    free (list);
+}
+
+static void
+waveform_index_event (const struct inotify_event *event)
+{
+    if (event->mask & IN_Q_OVERFLOW) {
+        waveform_index_scan_roots ();
+        return;
+    }
+    if (event->mask & IN_IGNORED) {
+        waveform_index_unwatch (event->wd);
+        return;
+    }
+    const char *dir = waveform_index_watch_path (event->wd);
+    if (!dir || !event->len || event->name[0] == '.') {
+        return;
+    }
+    char *path = waveform_index_join (dir, event->name);
+    if (!path) {
+        return;
+    }
+    if (event->mask & IN_ISDIR) {
+        if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+            waveform_index_scan (path);
+        }
+    }
+    else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+        waveform_index_file (path);
+    }
+    else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        waveform_db_library_delete (path);
+    }
+    free (path);
+}
+
+static void
+waveform_index_thread (void *ctx)
+{
+    waveform_throttle_io_priority (1);
+    waveform_index_scan_roots ();
+
+    char buffer[4096] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+    while (!waveform_index_stopping ()) {
+        struct pollfd pfd = { .fd = inotify_fd, .events = POLLIN };
+        if (poll (&pfd, 1, INDEX_POLL_TIMEOUT) <= 0) {
+            continue;
+        }
+        const ssize_t len = read (inotify_fd, buffer, sizeof (buffer));
+        for (ssize_t pos = 0; pos < len && !waveform_index_stopping (); ) {
+            const struct inotify_event *event = (const struct inotify_event *)(buffer + pos);
+            waveform_index_event (event);
+            pos += sizeof (struct inotify_event) + event->len;
+        }
+    }
+}
+
+void
+waveform_index_start (const char *new_roots, waveform_index_queue_func queue)
+{
+    if (tid && roots && !strcmp (roots, new_roots)) {
+        return;
+    }
+    waveform_index_stop ();
+    inotify_fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+    roots = strdup (new_roots);
+    if (inotify_fd < 0 || !roots) {
+        fprintf (stderr, "waveform: cannot start library indexer\n");
+        waveform_index_stop ();
+        return;
+    }
+    queue_func = queue;
+    stopping = 0;
+    tid = deadbeef->thread_start_low_priority (waveform_index_thread, NULL);
+    if (!tid) {
+        waveform_index_stop ();
+    }
+}
+
+void
+waveform_index_stop (void)
+{
+    if (tid) {
+        __atomic_store_n (&stopping, 1, __ATOMIC_RELEASE);
+        deadbeef->thread_join (tid);
+        tid = 0;
+    }
+    if (inotify_fd >= 0) {
+        close (inotify_fd);
+        inotify_fd = -1;
+    }
+    for (int i = 0; i < num_watches; i++) {
+        free (watches[i].path);
+    }
+    free (watches);
+    watches = NULL;
+    num_watches = 0;
+    free (roots);
+    roots = NULL;
+}
+
+#else
+
+void
+waveform_index_start (const char *roots, waveform_index_queue_func queue)
+{
+    fprintf (stderr, "waveform: the library indexer needs inotify\n");
+}
+
+void
+waveform_index_stop (void)
+{
+}
+
+#endif
@@ -0,0 +1,49 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    Based on sndfile-tools waveform by Erik de Castro Lopo.
+        waveform.c - v1.04
+        Copyright (C) 2007-2012 Erik de Castro Lopo <erikd@mega-nerd.com>
+        Copyright (C) 2012 Robin Gareus <robin@gareus.org>
+        Copyright (C) 2013 driedfruit <driedfruit@mindloop.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef INDEX_HEADER
+#define INDEX_HEADER
+
+#include <deadbeef/deadbeef.h>
+
+// Background indexer for a music library. The directories under the given
+// roots are scanned once and then watched with inotify, audio files that
+// are new or changed since their last analysis get their tracks handed to
+// the queue function. Which files are done is kept in the cache, so a
+// restart only queues what is still missing.
+
+// changed is set if the file was analyzed before and has been modified since
+typedef int (*waveform_index_queue_func) (DB_playItem_t *it, int changed);
+
+// roots is a list of directories separated by ';'. Restarts the indexer if
+// it is running with different roots.
+void
+waveform_index_start (const char *roots, waveform_index_queue_func queue);
+
+void
+waveform_index_stop (void);
+
+#endif
@@ -0,0 +1,575 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    Based on sndfile-tools waveform by Erik de Castro Lopo.
+        waveform.c - v1.04
+        Copyright (C) 2007-2012 Erik de Castro Lopo <erikd@mega-nerd.com>
+        Copyright (C) 2012 Robin Gareus <robin@gareus.org>
+        Copyright (C) 2013 driedfruit <driedfruit@mindloop.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "meter.h"
+#include "waveform.h"
+
+#ifndef MIN
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#endif
+#ifndef MAX
+#define MAX(a,b) (((a)>(b))?(a):(b))
+#endif
+
+// frames handled at a time, sized so the per channel scratch stays in cache
+#define METER_FRAMES (2048)
+#define METER_TAPS (12)
+#define METER_PHASES (4)
+// largest sum of the absolute taps of a phase, rounded up
+#define METER_TAP_GAIN (2.023f)
+// input samples checked for being too quiet at a time
+#define METER_SPAN (32)
+// 100 ms blocks, of which the short-term window takes 30
+#define METER_WINDOW_BLOCKS (30)
+// full scale of 16 bit audio, the largest value a clipped sample has
+#define METER_CLIP_LEVEL (32767.f / 32768.f)
+#define METER_GATE (-70.0)
+// crossover frequencies of the bands
+#define METER_BAND_SPLIT_LOW (200.0)
+#define METER_BAND_SPLIT_HIGH (2000.0)
+
+// interpolation filter of ITU-R BS.1770-4 annex 2, one row per phase
+static const float meter_taps[METER_PHASES][METER_TAPS] = {
+    {  0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f,
+      -0.0594482421875f,  0.1373291015625f,  0.9721679687500f, -0.1022949218750f,
+       0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+    { -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f,
+      -0.1665039062500f,  0.4650878906250f,  0.7797851562500f, -0.2003173828125f,
+       0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+    { -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f,
+      -0.2003173828125f,  0.7797851562500f,  0.4650878906250f, -0.1665039062500f,
+       0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+    { -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f,
+      -0.1022949218750f,  0.9721679687500f,  0.1373291015625f, -0.0594482421875f,
+       0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f },
+};
+
+// the four phases of one tap and the K-weighting of a pair of channels are
+// computed side by side
+typedef float meter_v4sf __attribute__ ((vector_size (16)));
+typedef int32_t meter_v4si __attribute__ ((vector_size (16)));
+typedef double meter_v2df __attribute__ ((vector_size (16)));
+
+typedef struct
+{
+    double b0, b1, b2, a1, a2;
+} meter_biquad_t;
+
+struct waveform_meter_s
+{
+    meter_v4sf taps[METER_TAPS];
+    int channels;
+    int stages;
+    float weights[MAX_CHANNELS];
+    // K-weighting: high shelf, then high pass
+    meter_biquad_t shelf;
+    meter_biquad_t highpass;
+    meter_v2df state[MAX_CHANNELS / 2][4];
+    // per channel the last METER_TAPS - 1 input samples followed by the
+    // deinterleaved frames being processed, an odd number of channels gets
+    // a silent one with weight 0 for the last pair
+    float *input[MAX_CHANNELS];
+    // weighted power and mix of all channels per frame
+    float *power;
+    float *mix;
+    // crossover: low and high pass at METER_BAND_SPLIT_LOW side by side,
+    // then the low pass at METER_BAND_SPLIT_HIGH of the upper part next to
+    // the high pass at METER_BAND_SPLIT_HIGH of the mix. b0, b1 - a1 * b0,
+    // b2 - a2 * b0, a1 and a2 of either lane.
+    meter_v2df crossover[2][5];
+    meter_v2df crossover_state[2][2];
+
+    // current column
+    float peak;
+    int64_t clips;
+    // energy of the finished blocks of the window, oldest first after next
+    double blocks[METER_WINDOW_BLOCKS];
+    int num_blocks;
+    int next_block;
+    int block_size;
+    double block_energy;
+    int block_frames;
+    // power of the split mix, low in split[0], mid and high in split[1]
+    meter_v2df split[2];
+    int64_t split_frames;
+    // max, min and sum of squares of mono, mid and side
+    meter_v4sf derived[3];
+    int64_t derived_frames;
+};
+
+// Coefficients as derived in libebur128 for any sample rate.
+static void
+waveform_meter_filters (waveform_meter_t *f, int samplerate)
+{
+    double f0 = 1681.974450955533;
+    const double gain = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = tan (M_PI * f0 / samplerate);
+    const double vh = pow (10.0, gain / 20.0);
+    const double vb = pow (vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    f->shelf = (meter_biquad_t) {
+        .b0 = (vh + vb * k / q + k * k) / a0,
+        .b1 = 2.0 * (k * k - vh) / a0,
+        .b2 = (vh - vb * k / q + k * k) / a0,
+        .a1 = 2.0 * (k * k - 1.0) / a0,
+        .a2 = (1.0 - k / q + k * k) / a0,
+    };
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = tan (M_PI * f0 / samplerate);
+    a0 = 1.0 + k / q + k * k;
+    f->highpass = (meter_biquad_t) {
+        .b0 = 1.0,
+        .b1 = -2.0,
+        .b2 = 1.0,
+        .a1 = 2.0 * (k * k - 1.0) / a0,
+        .a2 = (1.0 - k / q + k * k) / a0,
+    };
+}
+
+// Butterworth low or high pass from the audio EQ cookbook.
+static meter_biquad_t
+waveform_meter_butterworth (double f0, int samplerate, int highpass)
+{
+    const double w0 = 2.0 * M_PI * MIN (f0, 0.45 * samplerate) / samplerate;
+    const double cosw = cos (w0);
+    const double alpha = sin (w0) / (2.0 * M_SQRT1_2);
+    const double a0 = 1.0 + alpha;
+    const double b1 = (highpass ? -(1.0 + cosw) : 1.0 - cosw) / a0;
+    return (meter_biquad_t) {
+        .b0 = b1 / (highpass ? -2.0 : 2.0),
+        .b1 = b1,
+        .b2 = b1 / (highpass ? -2.0 : 2.0),
+        .a1 = -2.0 * cosw / a0,
+        .a2 = (1.0 - alpha) / a0,
+    };
+}
+
+static void
+waveform_meter_crossover (waveform_meter_t *f, int samplerate)
+{
+    const meter_biquad_t lanes[2][2] = {
+        {
+            waveform_meter_butterworth (METER_BAND_SPLIT_LOW, samplerate, 0),
+            waveform_meter_butterworth (METER_BAND_SPLIT_LOW, samplerate, 1),
+        },
+        {
+            waveform_meter_butterworth (METER_BAND_SPLIT_HIGH, samplerate, 0),
+            waveform_meter_butterworth (METER_BAND_SPLIT_HIGH, samplerate, 1),
+        },
+    };
+    for (int stage = 0; stage < 2; stage++) {
+        for (int lane = 0; lane < 2; lane++) {
+            const meter_biquad_t *b = &lanes[stage][lane];
+            f->crossover[stage][0][lane] = b->b0;
+            f->crossover[stage][1][lane] = b->b1 - b->a1 * b->b0;
+            f->crossover[stage][2][lane] = b->b2 - b->a2 * b->b0;
+            f->crossover[stage][3][lane] = b->a1;
+            f->crossover[stage][4][lane] = b->a2;
+        }
+    }
+}
+
+static void
+waveform_meter_derive_reset (waveform_meter_t *f)
+{
+    f->derived[0] = (meter_v4sf) { -1.f, -1.f, -1.f, -1.f };
+    f->derived[1] = (meter_v4sf) { 1.f, 1.f, 1.f, 1.f };
+    f->derived[2] = (meter_v4sf) { 0.f, 0.f, 0.f, 0.f };
+    f->derived_frames = 0;
+}
+
+waveform_meter_t *
+waveform_meter_new (int channels, int samplerate, int stages)
+{
+    if (channels <= 0 || channels > MAX_CHANNELS || samplerate <= 0) {
+        return NULL;
+    }
+    waveform_meter_t *f = calloc (1, sizeof (waveform_meter_t));
+    if (!f) {
+        return NULL;
+    }
+    f->channels = channels;
+    f->stages = stages;
+    // surround channels count more, the LFE channel not at all
+    for (int ch = 0; ch < channels; ch++) {
+        f->weights[ch] = 1.f;
+    }
+    if (channels == 5) {
+        f->weights[3] = f->weights[4] = 1.41f;
+    }
+    else if (channels == 6) {
+        f->weights[3] = 0.f;
+        f->weights[4] = f->weights[5] = 1.41f;
+    }
+    for (int k = 0; k < METER_TAPS; k++) {
+        for (int phase = 0; phase < METER_PHASES; phase++) {
+            f->taps[k][phase] = meter_taps[phase][k];
+        }
+    }
+    waveform_meter_filters (f, samplerate);
+    waveform_meter_crossover (f, samplerate);
+    waveform_meter_derive_reset (f);
+    f->block_size = MAX (1, samplerate / 10);
+    for (int ch = 0; ch < channels + channels % 2; ch++) {
+        f->input[ch] = calloc (METER_TAPS - 1 + METER_FRAMES, sizeof (float));
+        if (!f->input[ch]) {
+            waveform_meter_free (f);
+            return NULL;
+        }
+    }
+    f->power = malloc (METER_FRAMES * sizeof (float));
+    f->mix = malloc (METER_FRAMES * sizeof (float));
+    if (!f->power || !f->mix) {
+        waveform_meter_free (f);
+        return NULL;
+    }
+    return f;
+}
+
+void
+waveform_meter_free (waveform_meter_t *f)
+{
+    if (!f) {
+        return;
+    }
+    for (int ch = 0; ch < MAX_CHANNELS; ch++) {
+        free (f->input[ch]);
+    }
+    free (f->power);
+    free (f->mix);
+    free (f);
+}
+
+void
+waveform_meter_reset (waveform_meter_t *f)
+{
+    memset (f->state, 0, sizeof (f->state));
+    memset (f->crossover_state, 0, sizeof (f->crossover_state));
+    for (int ch = 0; ch < f->channels; ch++) {
+        memset (f->input[ch], 0, (METER_TAPS - 1) * sizeof (float));
+    }
+    f->num_blocks = 0;
+    f->next_block = 0;
+    f->block_energy = 0.0;
+    f->block_frames = 0;
+}
+
+// Largest absolute value of the 4x oversampled input, or peak if that is
+// larger. Each input sample yields the four output samples of one vector.
+// An output is at most METER_TAP_GAIN times the largest input it is made
+// of, so spans of input too quiet to beat the peak are not filtered.
+static float
+waveform_meter_true_peak (waveform_meter_t *f, const float *x, int frames, float peak)
+{
+    const meter_v4si sign = { INT32_MAX, INT32_MAX, INT32_MAX, INT32_MAX };
+    meter_v4sf best = { peak, peak, peak, peak };
+    for (int start = 0; start < frames; start += METER_SPAN) {
+        const int end = MIN (start + METER_SPAN, frames);
+        float loudest = 0.f;
+        for (int i = start; i < end + METER_TAPS - 1; i++) {
+            const float a = fabsf (x[i]);
+            loudest = a > loudest ? a : loudest;
+        }
+        if (loudest * METER_TAP_GAIN <= peak) {
+            continue;
+        }
+        for (int i = start; i < end; i++) {
+            const float *in = x + i + METER_TAPS - 1;
+            // two partial sums halve the chain of dependent additions
+            meter_v4sf even = f->taps[0] * in[0];
+            meter_v4sf odd = f->taps[1] * in[-1];
+            for (int k = 2; k < METER_TAPS; k += 2) {
+                even += f->taps[k] * in[-k];
+                odd += f->taps[k + 1] * in[-k - 1];
+            }
+            const meter_v4sf value = (meter_v4sf)((meter_v4si)(even + odd) & sign);
+            const meter_v4si greater = value > best;
+            best = (meter_v4sf)(((meter_v4si)value & greater) | ((meter_v4si)best & ~greater));
+        }
+        peak = MAX (MAX (best[0], best[1]), MAX (best[2], best[3]));
+    }
+    return peak;
+}
+
+// Adds the K-weighted power of the channels 2 * pair and 2 * pair + 1.
+static void
+waveform_meter_weigh (waveform_meter_t *f, int pair, int frames)
+{
+    const meter_biquad_t *s = &f->shelf;
+    const meter_biquad_t *h = &f->highpass;
+    // the state is updated from the input and the old state directly, which
+    // keeps the output out of the chain from one sample to the next
+    const meter_v2df sb0 = { s->b0, s->b0 };
+    const meter_v2df sc1 = { s->b1 - s->a1 * s->b0, s->b1 - s->a1 * s->b0 };
+    const meter_v2df sc2 = { s->b2 - s->a2 * s->b0, s->b2 - s->a2 * s->b0 };
+    const meter_v2df sa1 = { s->a1, s->a1 }, sa2 = { s->a2, s->a2 };
+    const meter_v2df hb0 = { h->b0, h->b0 };
+    const meter_v2df hc1 = { h->b1 - h->a1 * h->b0, h->b1 - h->a1 * h->b0 };
+    const meter_v2df hc2 = { h->b2 - h->a2 * h->b0, h->b2 - h->a2 * h->b0 };
+    const meter_v2df ha1 = { h->a1, h->a1 }, ha2 = { h->a2, h->a2 };
+    const meter_v2df weight = { f->weights[2 * pair], f->weights[2 * pair + 1] };
+    const float *x0 = f->input[2 * pair] + METER_TAPS - 1;
+    const float *x1 = f->input[2 * pair + 1] + METER_TAPS - 1;
+    meter_v2df z0 = f->state[pair][0];
+    meter_v2df z1 = f->state[pair][1];
+    meter_v2df z2 = f->state[pair][2];
+    meter_v2df z3 = f->state[pair][3];
+    for (int i = 0; i < frames; i++) {
+        // transposed direct form II
+        const meter_v2df x = { x0[i], x1[i] };
+        const meter_v2df y1 = sb0 * x + z0;
+        const meter_v2df s0 = z0;
+        z0 = (sc1 * x + z1) - sa1 * s0;
+        z1 = sc2 * x - sa2 * s0;
+        const meter_v2df y2 = hb0 * y1 + z2;
+        const meter_v2df h0 = z2;
+        z2 = (hc1 * y1 + z3) - ha1 * h0;
+        z3 = hc2 * y1 - ha2 * h0;
+        const meter_v2df power = weight * y2 * y2;
+        f->power[i] += (float)(power[0] + power[1]);
+    }
+    f->state[pair][0] = z0;
+    f->state[pair][1] = z1;
+    f->state[pair][2] = z2;
+    f->state[pair][3] = z3;
+}
+
+// Adds the power of the bands of the mix of all channels.
+static void
+waveform_meter_bands (waveform_meter_t *f, int frames)
+{
+    const meter_v2df *c0 = f->crossover[0];
+    const meter_v2df *c1 = f->crossover[1];
+    const double scale = 1.0 / f->channels;
+    meter_v2df z0 = f->crossover_state[0][0];
+    meter_v2df z1 = f->crossover_state[0][1];
+    meter_v2df z2 = f->crossover_state[1][0];
+    meter_v2df z3 = f->crossover_state[1][1];
+    meter_v2df low = f->split[0];
+    meter_v2df upper = f->split[1];
+    for (int i = 0; i < frames; i++) {
+        const double m = f->mix[i] * scale;
+        const meter_v2df x = { m, m };
+        const meter_v2df y1 = c0[0] * x + z0;
+        const meter_v2df s0 = z0;
+        z0 = (c0[1] * x + z1) - c0[3] * s0;
+        z1 = c0[2] * x - c0[4] * s0;
+        // the upper part of the first split and the mix again
+        const meter_v2df x2 = { y1[1], m };
+        const meter_v2df y2 = c1[0] * x2 + z2;
+        const meter_v2df s2 = z2;
+        z2 = (c1[1] * x2 + z3) - c1[3] * s2;
+        z3 = c1[2] * x2 - c1[4] * s2;
+        low += y1 * y1;
+        upper += y2 * y2;
+    }
+    f->crossover_state[0][0] = z0;
+    f->crossover_state[0][1] = z1;
+    f->crossover_state[1][0] = z2;
+    f->crossover_state[1][1] = z3;
+    f->split[0] = low;
+    f->split[1] = upper;
+    f->split_frames += frames;
+}
+
+// Max, min and power of mono, mid and side, one per lane.
+static void
+waveform_meter_derive (waveform_meter_t *f, int frames)
+{
+    const float scale = 1.f / f->channels;
+    const float *left = f->input[0] + METER_TAPS - 1;
+    // a single channel is its own mid, the silent pad its side
+    const float *right = f->input[f->channels > 1 ? 1 : 0] + METER_TAPS - 1;
+    const float side = f->channels > 1 ? 0.5f : 0.f;
+    meter_v4sf max = f->derived[0];
+    meter_v4sf min = f->derived[1];
+    meter_v4sf sum = f->derived[2];
+    for (int i = 0; i < frames; i++) {
+        const meter_v4sf x = {
+            f->mix[i] * scale,
+            (left[i] + right[i]) * 0.5f,
+            (left[i] - right[i]) * side,
+            0.f,
+        };
+        const meter_v4si greater = x > max;
+        const meter_v4si less = x < min;
+        max = (meter_v4sf)(((meter_v4si)x & greater) | ((meter_v4si)max & ~greater));
+        min = (meter_v4sf)(((meter_v4si)x & less) | ((meter_v4si)min & ~less));
+        sum += x * x;
+    }
+    f->derived[0] = max;
+    f->derived[1] = min;
+    f->derived[2] = sum;
+    f->derived_frames += frames;
+}
+
+static void
+waveform_meter_blocks (waveform_meter_t *f, int frames)
+{
+    for (int i = 0; i < frames; i++) {
+        f->block_energy += f->power[i];
+        if (++f->block_frames == f->block_size) {
+            f->blocks[f->next_block] = f->block_energy;
+            f->next_block = (f->next_block + 1) % METER_WINDOW_BLOCKS;
+            f->num_blocks = MIN (f->num_blocks + 1, METER_WINDOW_BLOCKS);
+            f->block_energy = 0.0;
+            f->block_frames = 0;
+        }
+    }
+}
+
+void
+waveform_meter_process (waveform_meter_t *f, const float *data, int frames)
+{
+    const int channels = f->channels;
+    const int levels = f->stages & METER_LEVELS;
+    const int bands = f->stages & METER_BANDS;
+    const int derived = f->stages & METER_MIX;
+    while (frames > 0) {
+        const int n = MIN (frames, METER_FRAMES);
+        memset (f->power, 0, n * sizeof (float));
+        memset (f->mix, 0, n * sizeof (float));
+        for (int ch = 0; ch < channels; ch++) {
+            float *x = f->input[ch];
+            float *in = x + METER_TAPS - 1;
+            for (int i = 0; i < n; i++) {
+                in[i] = data[i * channels + ch];
+            }
+            if (bands || derived) {
+                for (int i = 0; i < n; i++) {
+                    f->mix[i] += in[i];
+                }
+            }
+            if (!levels) {
+                continue;
+            }
+            int64_t clips = 0;
+            float peak = f->peak;
+            for (int i = 0; i < n; i++) {
+                const float a = fabsf (in[i]);
+                clips += a >= METER_CLIP_LEVEL;
+                peak = a > peak ? a : peak;
+            }
+            f->clips += clips;
+            f->peak = waveform_meter_true_peak (f, x, n, peak);
+        }
+        if (levels) {
+            for (int pair = 0; pair < (channels + 1) / 2; pair++) {
+                waveform_meter_weigh (f, pair, n);
+            }
+            for (int ch = 0; ch < channels; ch++) {
+                memmove (f->input[ch], f->input[ch] + n, (METER_TAPS - 1) * sizeof (float));
+            }
+            waveform_meter_blocks (f, n);
+        }
+        if (bands) {
+            waveform_meter_bands (f, n);
+        }
+        if (derived) {
+            waveform_meter_derive (f, n);
+        }
+        data += n * channels;
+        frames -= n;
+    }
+}
+
+static short
+waveform_meter_rms (double power, int64_t frames)
+{
+    return frames > 0 ? (short)MIN (sqrt (power / frames) * 1000.0, SHRT_MAX) : 0;
+}
+
+void
+waveform_meter_store (waveform_meter_t *f, short *values)
+{
+    waveform_meter_clear (values, 1);
+    if (f->stages & METER_BANDS) {
+        values[METER_BAND_LOW] = waveform_meter_rms (f->split[0][0], f->split_frames);
+        values[METER_BAND_MID] = waveform_meter_rms (f->split[1][0], f->split_frames);
+        values[METER_BAND_HIGH] = waveform_meter_rms (f->split[1][1], f->split_frames);
+        f->split[0] = f->split[1] = (meter_v2df) { 0.0, 0.0 };
+        f->split_frames = 0;
+    }
+    if ((f->stages & METER_MIX) && f->derived_frames > 0) {
+        for (int k = 0; k < 3; k++) {
+            short *out = values + METER_MONO + k * VALUES_PER_SAMPLE;
+            out[0] = (short)(f->derived[0][k] * 1000);
+            out[1] = (short)(f->derived[1][k] * 1000);
+            out[2] = (short)(sqrt (f->derived[2][k] / f->derived_frames) * 1000);
+        }
+    }
+    if (f->stages & METER_MIX) {
+        waveform_meter_derive_reset (f);
+    }
+    if (!(f->stages & METER_LEVELS)) {
+        return;
+    }
+    values[METER_TRUE_PEAK] = (short)MIN (f->peak * 1000.f, SHRT_MAX);
+    values[METER_CLIPS] = (short)MIN (f->clips, SHRT_MAX);
+
+    // the window ends with the block in progress
+    const int blocks = MIN (f->num_blocks, METER_WINDOW_BLOCKS - (f->block_frames > 0));
+    double energy = f->block_energy;
+    for (int i = 1; i <= blocks; i++) {
+        energy += f->blocks[(f->next_block - i + METER_WINDOW_BLOCKS) % METER_WINDOW_BLOCKS];
+    }
+    const int64_t frames = (int64_t)blocks * f->block_size + f->block_frames;
+    if (frames > 0 && energy > 0.0) {
+        const double loudness = -0.691 + 10.0 * log10 (energy / frames);
+        if (loudness >= METER_GATE) {
+            values[METER_LOUDNESS] = (short)lrint (loudness * 100.0);
+        }
+    }
+    f->peak = 0.f;
+    f->clips = 0;
+}
+
+void
+waveform_meter_clear (short *values, int columns)
+{
+    for (int c = 0; c < columns; c++, values += METER_VALUES) {
+        values[METER_TRUE_PEAK] = 0;
+        values[METER_CLIPS] = 0;
+        values[METER_LOUDNESS] = METER_LOUDNESS_NONE;
+        values[METER_BAND_LOW] = 0;
+        values[METER_BAND_MID] = 0;
+        values[METER_BAND_HIGH] = 0;
+        for (int k = METER_MONO; k < METER_SIDE + VALUES_PER_SAMPLE; k += VALUES_PER_SAMPLE) {
+            values[k] = METER_MIX_NONE;
+            values[k + 1] = 0;
+            values[k + 2] = 0;
+        }
+    }
+}
@@ -0,0 +1,84 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    Based on sndfile-tools waveform by Erik de Castro Lopo.
+        waveform.c - v1.04
+        Copyright (C) 2007-2012 Erik de Castro Lopo <erikd@mega-nerd.com>
+        Copyright (C) 2012 Robin Gareus <robin@gareus.org>
+        Copyright (C) 2013 driedfruit <driedfruit@mindloop.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef METER_HEADER
+#define METER_HEADER
+
+// Mastering meters for the analyzed columns, computed from the same PCM as
+// the waveform: the true peak (4x oversampled as in ITU-R BS.1770), the
+// number of clipped samples and the EBU R128 short-term loudness (K-weighted,
+// 3 s window) at the end of the column, and the spectral balance as the RMS
+// of the mix below 200 Hz, between 200 Hz and 2 kHz and above 2 kHz. A
+// column is METER_VALUES values: the peak as linear amplitude * 1000, the
+// clip count saturated at SHRT_MAX, the loudness in LUFS * 100 or
+// METER_LOUDNESS_NONE, the band levels as linear amplitude * 1000 and the
+// derived channels mono (mean of all channels), mid and side (of the front
+// pair) with max, min and RMS as in the waveform, max being
+// METER_MIX_NONE if there are none.
+#define METER_VALUES (15)
+#define METER_TRUE_PEAK (0)
+#define METER_CLIPS (1)
+#define METER_LOUDNESS (2)
+#define METER_BAND_LOW (3)
+#define METER_BAND_MID (4)
+#define METER_BAND_HIGH (5)
+#define METER_MONO (6)
+#define METER_MID (9)
+#define METER_SIDE (12)
+// silence below the absolute gate, or no audio analyzed yet
+#define METER_LOUDNESS_NONE (-32768)
+#define METER_MIX_NONE (-32768)
+
+// what a meter measures, values of the other stage are left as cleared
+#define METER_LEVELS (1 << 0)
+#define METER_BANDS (1 << 1)
+#define METER_MIX (1 << 2)
+
+typedef struct waveform_meter_s waveform_meter_t;
+
+waveform_meter_t *
+waveform_meter_new (int channels, int samplerate, int stages);
+
+void
+waveform_meter_free (waveform_meter_t *f);
+
+// Forgets the filter history, for a jump in the input.
+void
+waveform_meter_reset (waveform_meter_t *f);
+
+// Adds interleaved frames to the current column.
+void
+waveform_meter_process (waveform_meter_t *f, const float *data, int frames);
+
+// Writes the values of the current column and starts the next one.
+void
+waveform_meter_store (waveform_meter_t *f, short *values);
+
+// Values for columns without any analyzed audio.
+void
+waveform_meter_clear (short *values, int columns);
+
+#endif
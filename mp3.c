@@ -0,0 +1,445 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    Based on sndfile-tools waveform by Erik de Castro Lopo.
+        waveform.c - v1.04
+        Copyright (C) 2007-2012 Erik de Castro Lopo <erikd@mega-nerd.com>
+        Copyright (C) 2012 Robin Gareus <robin@gareus.org>
+        Copyright (C) 2013 driedfruit <driedfruit@mindloop.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mp3.h"
+#include "waveform.h"
+
+#ifndef MIN
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#endif
+#ifndef MAX
+#define MAX(a,b) (((a)>(b))?(a):(b))
+#endif
+
+#define MP3_GRANULE_FRAMES (576)
+// consecutive frames that must parse before a file is taken for an MP3
+#define MP3_SYNC_FRAMES (3)
+// bytes searched for the first frame after any ID3v2 tag
+#define MP3_SYNC_SEARCH (65536)
+// largest main_data_begin plus the largest frame
+#define MP3_RESERVOIR (512 + 1444)
+// ratio of peak to rms assumed for the estimate
+#define MP3_CREST_FACTOR (2.8f)
+// the loudest column of a file is drawn at this level
+#define MP3_PEAK_LEVEL (0.9f)
+
+typedef struct
+{
+    int version;
+    // MPEG 2 and 2.5 have one granule per frame and a shorter side info
+    int lsf;
+    int channels;
+    int samplerate;
+    int crc;
+    int ms_stereo;
+    int length;
+    int side_info;
+} mp3_frame_t;
+
+typedef struct
+{
+    int part2_3_length;
+    int big_values;
+    int global_gain;
+    int scalefac_compress;
+    int block_type;
+    int mixed;
+    int subblock_gain[3];
+    int preflag;
+    int scalefac_scale;
+} mp3_granule_t;
+
+typedef struct
+{
+    const unsigned char *data;
+    size_t len;
+    size_t pos;
+} mp3_bits_t;
+
+static const int bitrates[2][16] = {
+    { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 },
+    { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0 },
+};
+static const int samplerates[3] = { 44100, 48000, 32000 };
+static const int slen[2][16] = {
+    { 0, 0, 0, 0, 3, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4 },
+    { 0, 1, 2, 3, 0, 1, 2, 3, 1, 2, 3, 1, 2, 3, 2, 3 },
+};
+static const int pretab[21] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 3, 3, 3, 2 };
+
+static unsigned
+mp3_get (mp3_bits_t *b, int n)
+{
+    unsigned value = 0;
+    for (int i = 0; i < n; i++, b->pos++) {
+        const int bit = b->pos < b->len * 8 ? (b->data[b->pos >> 3] >> (7 - (b->pos & 7))) & 1 : 0;
+        value = (value << 1) | bit;
+    }
+    return value;
+}
+
+static int
+mp3_frame_parse (const unsigned char *p, size_t avail, mp3_frame_t *f)
+{
+    if (avail < 4 || p[0] != 0xff || (p[1] & 0xe0) != 0xe0) {
+        return -1;
+    }
+    // 0: MPEG 2.5, 2: MPEG 2, 3: MPEG 1
+    const int version = (p[1] >> 3) & 3;
+    const int layer = (p[1] >> 1) & 3;
+    const int bitrate_index = p[2] >> 4;
+    const int samplerate_index = (p[2] >> 2) & 3;
+    if (version == 1 || layer != 1 || bitrate_index == 0 || bitrate_index == 15 || samplerate_index == 3) {
+        return -1;
+    }
+    f->version = version;
+    f->lsf = version != 3;
+    f->samplerate = samplerates[samplerate_index] >> (version == 3 ? 0 : version == 2 ? 1 : 2);
+    f->crc = !(p[1] & 1);
+    const int mode = p[3] >> 6;
+    f->channels = mode == 3 ? 1 : 2;
+    f->ms_stereo = mode == 1 && (p[3] & 0x20);
+    const int bitrate = bitrates[f->lsf][bitrate_index] * 1000;
+    f->length = (f->lsf ? 72 : 144) * bitrate / f->samplerate + ((p[2] >> 1) & 1);
+    f->side_info = f->lsf ? (f->channels == 1 ? 9 : 17) : (f->channels == 1 ? 17 : 32);
+    return 0;
+}
+
+static int
+mp3_frame_same (const mp3_frame_t *a, const mp3_frame_t *b)
+{
+    return a->version == b->version && a->samplerate == b->samplerate && a->channels == b->channels;
+}
+
+static void
+mp3_side_info (mp3_bits_t *b, const mp3_frame_t *f, int *main_data_begin, int scfsi[2][4], mp3_granule_t granules[2][2])
+{
+    *main_data_begin = mp3_get (b, f->lsf ? 8 : 9);
+    mp3_get (b, f->lsf ? f->channels : (f->channels == 1 ? 5 : 3));
+    for (int ch = 0; ch < f->channels; ch++) {
+        for (int band = 0; band < 4; band++) {
+            scfsi[ch][band] = f->lsf ? 0 : mp3_get (b, 1);
+        }
+    }
+    for (int gr = 0; gr < (f->lsf ? 1 : 2); gr++) {
+        for (int ch = 0; ch < f->channels; ch++) {
+            mp3_granule_t *gi = &granules[gr][ch];
+            gi->part2_3_length = mp3_get (b, 12);
+            gi->big_values = mp3_get (b, 9);
+            gi->global_gain = mp3_get (b, 8);
+            gi->scalefac_compress = mp3_get (b, f->lsf ? 9 : 4);
+            if (mp3_get (b, 1)) {
+                gi->block_type = mp3_get (b, 2);
+                gi->mixed = mp3_get (b, 1);
+                mp3_get (b, 10);
+                for (int w = 0; w < 3; w++) {
+                    gi->subblock_gain[w] = mp3_get (b, 3);
+                }
+            }
+            else {
+                gi->block_type = 0;
+                gi->mixed = 0;
+                memset (gi->subblock_gain, 0, sizeof (gi->subblock_gain));
+                mp3_get (b, 15 + 4 + 3);
+            }
+            gi->preflag = f->lsf ? 0 : mp3_get (b, 1);
+            gi->scalefac_scale = mp3_get (b, 1);
+            mp3_get (b, 1);
+        }
+    }
+}
+
+// Reads the MPEG 1 scalefactors at the start of a granule's main data.
+// Returns their mean over the low bands, where most of the energy is.
+static float
+mp3_scalefactors (mp3_bits_t *b, const mp3_granule_t *gi, int gr, const int *scfsi, int *sf_long)
+{
+    const int slen1 = slen[0][gi->scalefac_compress];
+    const int slen2 = slen[1][gi->scalefac_compress];
+    int sum = 0;
+    int n = 0;
+    if (gi->block_type == 2) {
+        if (gi->mixed) {
+            for (int sfb = 0; sfb < 8; sfb++, n++) {
+                sum += mp3_get (b, slen1);
+            }
+        }
+        for (int sfb = gi->mixed ? 3 : 0; sfb < 12; sfb++) {
+            for (int w = 0; w < 3; w++) {
+                const int sf = mp3_get (b, sfb < 6 ? slen1 : slen2);
+                if (sfb < 6) {
+                    sum += sf;
+                    n++;
+                }
+            }
+        }
+        return n > 0 ? (float)sum / n : 0.f;
+    }
+    static const int groups[5] = { 0, 6, 11, 16, 21 };
+    for (int i = 0; i < 4; i++) {
+        if (gr == 0 || !scfsi[i]) {
+            for (int sfb = groups[i]; sfb < groups[i + 1]; sfb++) {
+                sf_long[sfb] = mp3_get (b, i < 2 ? slen1 : slen2);
+            }
+        }
+    }
+    for (int sfb = 0; sfb < 11; sfb++) {
+        sum += sf_long[sfb] + gi->preflag * pretab[sfb];
+    }
+    return sum / 11.f;
+}
+
+// Rough rms of the granule's output, from its quantizer step and the bits
+// its Huffman coded values take.
+static float
+mp3_granule_rms (const mp3_granule_t *gi, int part2_bits, float sf_mean)
+{
+    const int huffman_bits = gi->part2_3_length - part2_bits;
+    if (huffman_bits <= 0) {
+        return 0.f;
+    }
+    float exponent = (gi->global_gain - 210) / 4.f - 0.5f * (1 + gi->scalefac_scale) * sf_mean;
+    if (gi->block_type == 2) {
+        exponent -= 2.f * (gi->subblock_gain[0] + gi->subblock_gain[1] + gi->subblock_gain[2]) / 3.f;
+    }
+    // the count1 region holds at least a quadruple of +-1
+    const int values = MAX (2 * MIN (gi->big_values, MP3_GRANULE_FRAMES / 2), 4);
+    // a magnitude m takes about log2 (1 + m) bits plus the sign
+    const float magnitude = MAX (1.f, exp2f ((float)huffman_bits / values - 1.f) - 1.f);
+    const float level = exp2f (exponent) * powf (magnitude, 4.f / 3.f);
+    return level * sqrtf ((float)values / MP3_GRANULE_FRAMES);
+}
+
+// Offset of the first of MP3_SYNC_FRAMES matching frames, or -1.
+static int64_t
+mp3_sync (const unsigned char *map, size_t size, mp3_frame_t *first)
+{
+    size_t pos = 0;
+    if (size >= 10 && !memcmp (map, "ID3", 3)) {
+        const size_t tag = ((map[6] & 0x7f) << 21) | ((map[7] & 0x7f) << 14) | ((map[8] & 0x7f) << 7) | (map[9] & 0x7f);
+        pos = 10 + tag + ((map[5] & 0x10) ? 10 : 0);
+    }
+    const size_t search_end = MIN (size, pos + MP3_SYNC_SEARCH);
+    for (; pos < search_end; pos++) {
+        if (mp3_frame_parse (map + pos, size - pos, first) != 0) {
+            continue;
+        }
+        size_t next = pos + first->length;
+        int n = 1;
+        mp3_frame_t f;
+        while (n < MP3_SYNC_FRAMES && mp3_frame_parse (map + next, next < size ? size - next : 0, &f) == 0 && mp3_frame_same (first, &f)) {
+            next += f.length;
+            n++;
+        }
+        if (n == MP3_SYNC_FRAMES) {
+            return (int64_t)pos;
+        }
+    }
+    return -1;
+}
+
+// Xing, Info and VBRI frames carry no audio.
+static int
+mp3_frame_is_tag (const unsigned char *p, const mp3_frame_t *f)
+{
+    const int offset = 4 + (f->crc ? 2 : 0) + f->side_info;
+    if (offset + 4 <= f->length && (!memcmp (p + offset, "Xing", 4) || !memcmp (p + offset, "Info", 4))) {
+        return 1;
+    }
+    return 36 + 4 <= f->length && !memcmp (p + 36, "VBRI", 4);
+}
+
+static void
+mp3_scan (const unsigned char *map, size_t size, size_t pos, const mp3_frame_t *format,
+          int64_t start, int64_t total_frames, int num_columns, float *peak, float *sum, int *count)
+{
+    unsigned char reservoir[MP3_RESERVOIR];
+    size_t reservoir_len = 0;
+    int sf_long[2][21];
+    memset (sf_long, 0, sizeof (sf_long));
+    int64_t granule_frame = -start;
+    int first = 1;
+
+    while (pos + 4 <= size) {
+        mp3_frame_t f;
+        if (mp3_frame_parse (map + pos, size - pos, &f) != 0 || !mp3_frame_same (format, &f) || pos + f.length > size) {
+            // lost sync, start over at the next frame that parses
+            pos++;
+            reservoir_len = 0;
+            continue;
+        }
+        const unsigned char *frame = map + pos;
+        pos += f.length;
+        if (first && mp3_frame_is_tag (frame, &f)) {
+            first = 0;
+            continue;
+        }
+        first = 0;
+
+        const int header_len = 4 + (f.crc ? 2 : 0);
+        if (header_len + f.side_info > f.length) {
+            reservoir_len = 0;
+            continue;
+        }
+        mp3_bits_t side = { frame + header_len, f.side_info, 0 };
+        int main_data_begin = 0;
+        int scfsi[2][4];
+        mp3_granule_t granules[2][2];
+        mp3_side_info (&side, &f, &main_data_begin, scfsi, granules);
+
+        // main data may start in earlier frames, see the bit reservoir
+        const size_t main_len = f.length - header_len - f.side_info;
+        if (reservoir_len > 511) {
+            memmove (reservoir, reservoir + reservoir_len - 511, 511);
+            reservoir_len = 511;
+        }
+        const int have_main = (size_t)main_data_begin <= reservoir_len;
+        const size_t main_start = have_main ? reservoir_len - main_data_begin : 0;
+        memcpy (reservoir + reservoir_len, frame + header_len + f.side_info, main_len);
+        reservoir_len += main_len;
+        mp3_bits_t main_bits = { reservoir + main_start, reservoir_len - main_start, 0 };
+
+        for (int gr = 0; gr < (f.lsf ? 1 : 2); gr++, granule_frame += MP3_GRANULE_FRAMES) {
+            float rms[2] = { 0.f, 0.f };
+            for (int ch = 0; ch < f.channels; ch++) {
+                const mp3_granule_t *gi = &granules[gr][ch];
+                const size_t part_start = main_bits.pos;
+                float sf_mean = 0.f;
+                int part2_bits = 0;
+                if (have_main && !f.lsf) {
+                    sf_mean = mp3_scalefactors (&main_bits, gi, gr, scfsi[ch], sf_long[ch]);
+                    part2_bits = (int)(main_bits.pos - part_start);
+                }
+                main_bits.pos = part_start + gi->part2_3_length;
+                rms[ch] = mp3_granule_rms (gi, part2_bits, sf_mean);
+            }
+            if (f.ms_stereo) {
+                // both sides get the combined level of mid and side
+                rms[0] = rms[1] = sqrtf ((rms[0] * rms[0] + rms[1] * rms[1]) / 2.f);
+            }
+
+            const int64_t center = granule_frame + MP3_GRANULE_FRAMES / 2;
+            if (center < 0) {
+                continue;
+            }
+            const int column = (int)(center * num_columns / total_frames);
+            if (column >= num_columns) {
+                return;
+            }
+            for (int ch = 0; ch < f.channels; ch++) {
+                const int i = column * f.channels + ch;
+                peak[i] = MAX (peak[i], rms[ch] * MP3_CREST_FACTOR);
+                sum[i] += rms[ch] * rms[ch];
+            }
+            count[column]++;
+        }
+    }
+}
+
+int
+waveform_mp3_envelope (const char *path, int64_t start, float duration, int num_columns, short *data, size_t data_size)
+{
+    const int fd = open (path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    struct stat st;
+    if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode) || st.st_size < 4 || (uint64_t)st.st_size > SIZE_MAX) {
+        close (fd);
+        return 0;
+    }
+    const size_t size = (size_t)st.st_size;
+    unsigned char *map = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+    madvise (map, size, MADV_SEQUENTIAL);
+
+    int channels = 0;
+    float *peak = NULL;
+    float *sum = NULL;
+    int *count = NULL;
+    mp3_frame_t format;
+    const int64_t pos = mp3_sync (map, size, &format);
+    const int64_t total_frames = pos >= 0 ? (int64_t)((double)duration * format.samplerate) : 0;
+    if (total_frames <= 0 || num_columns <= 0 || (size_t)num_columns * format.channels * VALUES_PER_SAMPLE > data_size) {
+        goto out;
+    }
+    peak = calloc ((size_t)num_columns * format.channels, sizeof (float));
+    sum = calloc ((size_t)num_columns * format.channels, sizeof (float));
+    count = calloc (num_columns, sizeof (int));
+    if (!peak || !sum || !count) {
+        goto out;
+    }
+    mp3_scan (map, size, (size_t)pos, &format, start, total_frames, num_columns, peak, sum, count);
+
+    float loudest = 0.f;
+    for (int i = 0; i < num_columns * format.channels; i++) {
+        loudest = MAX (loudest, peak[i]);
+    }
+    if (loudest <= 0.f) {
+        goto out;
+    }
+    // levels are only known relative to each other
+    const float scale = MP3_PEAK_LEVEL / loudest;
+    // columns narrower than a granule repeat the one before, leading ones
+    // the first with a granule
+    int last = 0;
+    while (last < num_columns - 1 && count[last] == 0) {
+        last++;
+    }
+    for (int c = 0; c < num_columns; c++) {
+        if (count[c] > 0) {
+            last = c;
+        }
+        const int src = count[last] > 0 ? last : -1;
+        short *values = data + c * format.channels * VALUES_PER_SAMPLE;
+        for (int ch = 0; ch < format.channels; ch++, values += VALUES_PER_SAMPLE) {
+            const float max = src >= 0 ? peak[src * format.channels + ch] * scale : 0.f;
+            const float rms = src >= 0 ? sqrtf (sum[src * format.channels + ch] / count[src]) * scale : 0.f;
+            values[0] = (short)(max * 1000);
+            values[1] = (short)(-max * 1000);
+            values[2] = (short)(MIN (rms, max) * 1000);
+        }
+    }
+    channels = format.channels;
+
+out:
+    free (peak);
+    free (sum);
+    free (count);
+    munmap (map, size);
+    return channels;
+}
@@ -0,0 +1,41 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    Based on sndfile-tools waveform by Erik de Castro Lopo.
+        waveform.c - v1.04
+        Copyright (C) 2007-2012 Erik de Castro Lopo <erikd@mega-nerd.com>
+        Copyright (C) 2012 Robin Gareus <robin@gareus.org>
+        Copyright (C) 2013 driedfruit <driedfruit@mindloop.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef MP3_HEADER
+#define MP3_HEADER
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Estimates max, min and rms of each column of an MPEG audio layer III file
+// from the side information and scalefactors of its granules, without
+// decoding any samples. The result is only a rough envelope. Columns are
+// spread over duration seconds starting at frame start of the stream.
+// Returns the number of channels, or 0 if path isn't a usable MP3 file.
+int
+waveform_mp3_envelope (const char *path, int64_t start, float duration, int num_columns, short *data, size_t data_size);
+
+#endif
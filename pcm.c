@@ -0,0 +1,347 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    Based on sndfile-tools waveform by Erik de Castro Lopo.
+        waveform.c - v1.04
+        Copyright (C) 2007-2012 Erik de Castro Lopo <erikd@mega-nerd.com>
+        Copyright (C) 2012 Robin Gareus <robin@gareus.org>
+        Copyright (C) 2013 driedfruit <driedfruit@mindloop.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pcm.h"
+#include "waveform.h"
+
+#ifndef MIN
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#endif
+
+#define WAVE_FORMAT_PCM (0x0001)
+#define WAVE_FORMAT_IEEE_FLOAT (0x0003)
+#define WAVE_FORMAT_EXTENSIBLE (0xfffe)
+
+// the W64 chunk GUIDs used here share these last 12 bytes
+static const unsigned char w64_guid_tail[12] = {
+    0xf3, 0xac, 0xd3, 0x11, 0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a
+};
+static const unsigned char w64_riff_guid[16] = {
+    'r', 'i', 'f', 'f', 0x2e, 0x91, 0xcf, 0x11, 0xa5, 0xd6, 0x28, 0xdb, 0x04, 0xc1, 0x00, 0x00
+};
+
+static inline uint16_t
+le16 (const unsigned char *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t
+le32 (const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t
+le64 (const unsigned char *p)
+{
+    return le32 (p) | ((uint64_t)le32 (p + 4) << 32);
+}
+
+static inline uint16_t
+be16 (const unsigned char *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static inline uint32_t
+be32 (const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+// 80 bit IEEE 754 extended precision, as used for the AIFF sample rate
+static double
+be_extended (const unsigned char *p)
+{
+    const int exponent = ((p[0] & 0x7f) << 8) | p[1];
+    const uint64_t mantissa = ((uint64_t)be32 (p + 2) << 32) | be32 (p + 6);
+    const double value = ldexp ((double)mantissa, exponent - 16383 - 63);
+    return p[0] & 0x80 ? -value : value;
+}
+
+static int
+waveform_pcm_fmt (waveform_pcm_t *pcm, const unsigned char *p, uint64_t size)
+{
+    if (size < 16) {
+        return -1;
+    }
+    int format = le16 (p);
+    pcm->channels = le16 (p + 2);
+    pcm->samplerate = (int)le32 (p + 4);
+    const int block_align = le16 (p + 12);
+    pcm->bps = le16 (p + 14);
+    if (format == WAVE_FORMAT_EXTENSIBLE) {
+        if (size < 40) {
+            return -1;
+        }
+        // the sub format GUID starts with the actual format tag
+        format = le16 (p + 24);
+    }
+    if (format == WAVE_FORMAT_IEEE_FLOAT) {
+        pcm->is_float = 1;
+    }
+    else if (format != WAVE_FORMAT_PCM) {
+        return -1;
+    }
+    pcm->is_unsigned = pcm->bps == 8;
+    return block_align == pcm->channels * (pcm->bps / 8) ? 0 : -1;
+}
+
+// RIFF and RF64, whose 64 bit sizes are in the ds64 chunk
+static int
+waveform_pcm_parse_wav (waveform_pcm_t *pcm, const unsigned char *map, uint64_t map_size)
+{
+    const int rf64 = !memcmp (map, "RF64", 4);
+    uint64_t data_size64 = 0;
+    int have_fmt = 0;
+    uint64_t pos = 12;
+    while (pos + 8 <= map_size) {
+        const unsigned char *chunk = map + pos;
+        uint64_t size = le32 (chunk + 4);
+        if (!memcmp (chunk, "ds64", 4) && size >= 16 && pos + 8 + 16 <= map_size) {
+            data_size64 = le64 (chunk + 8 + 8);
+        }
+        else if (!memcmp (chunk, "fmt ", 4)) {
+            if (pos + 8 + size > map_size || waveform_pcm_fmt (pcm, chunk + 8, size) != 0) {
+                return -1;
+            }
+            have_fmt = 1;
+        }
+        else if (!memcmp (chunk, "data", 4)) {
+            if (!have_fmt) {
+                return -1;
+            }
+            if (rf64 && size == 0xffffffff) {
+                size = data_size64;
+            }
+            pcm->data = chunk + 8;
+            // a file cut short still has its first part
+            pcm->frames = (int64_t)(MIN (size, map_size - pos - 8) / (pcm->channels * (pcm->bps / 8)));
+            return 0;
+        }
+        pos += 8 + size + (size & 1);
+    }
+    return -1;
+}
+
+static int
+waveform_pcm_parse_w64 (waveform_pcm_t *pcm, const unsigned char *map, uint64_t map_size)
+{
+    int have_fmt = 0;
+    uint64_t pos = 40;
+    while (pos + 24 <= map_size) {
+        const unsigned char *chunk = map + pos;
+        const uint64_t size = le64 (chunk + 16);
+        if (size < 24) {
+            return -1;
+        }
+        const int known = !memcmp (chunk + 4, w64_guid_tail, sizeof (w64_guid_tail));
+        if (known && !memcmp (chunk, "fmt ", 4)) {
+            if (pos + size > map_size || waveform_pcm_fmt (pcm, chunk + 24, size - 24) != 0) {
+                return -1;
+            }
+            have_fmt = 1;
+        }
+        else if (known && !memcmp (chunk, "data", 4)) {
+            if (!have_fmt) {
+                return -1;
+            }
+            pcm->data = chunk + 24;
+            pcm->frames = (int64_t)(MIN (size - 24, map_size - pos - 24) / (pcm->channels * (pcm->bps / 8)));
+            return 0;
+        }
+        pos += (size + 7) & ~(uint64_t)7;
+    }
+    return -1;
+}
+
+static int
+waveform_pcm_parse_aiff (waveform_pcm_t *pcm, const unsigned char *map, uint64_t map_size)
+{
+    const int aifc = !memcmp (map + 8, "AIFC", 4);
+    int have_comm = 0;
+    uint64_t pos = 12;
+    pcm->is_bigendian = 1;
+    while (pos + 8 <= map_size) {
+        const unsigned char *chunk = map + pos;
+        const uint64_t size = be32 (chunk + 4);
+        if (pos + 8 + size > map_size && memcmp (chunk, "SSND", 4)) {
+            return -1;
+        }
+        if (!memcmp (chunk, "COMM", 4)) {
+            if (size < (aifc ? 22 : 18)) {
+                return -1;
+            }
+            pcm->channels = be16 (chunk + 8);
+            pcm->bps = be16 (chunk + 14);
+            pcm->samplerate = (int)be_extended (chunk + 16);
+            if (aifc) {
+                const unsigned char *compression = chunk + 26;
+                if (!memcmp (compression, "sowt", 4)) {
+                    pcm->is_bigendian = 0;
+                }
+                else if (!memcmp (compression, "fl32", 4) || !memcmp (compression, "FL32", 4)
+                         || !memcmp (compression, "fl64", 4) || !memcmp (compression, "FL64", 4)) {
+                    pcm->is_float = 1;
+                }
+                else if (memcmp (compression, "NONE", 4)) {
+                    return -1;
+                }
+            }
+            // sample sizes that aren't whole bytes are padded to the next one
+            pcm->bps = (pcm->bps + 7) / 8 * 8;
+            have_comm = 1;
+        }
+        else if (!memcmp (chunk, "SSND", 4)) {
+            if (!have_comm || size < 8 || pos + 16 > map_size) {
+                return -1;
+            }
+            const uint64_t offset = be32 (chunk + 8);
+            const uint64_t start = pos + 16 + offset;
+            if (offset > size - 8 || start > map_size) {
+                return -1;
+            }
+            pcm->data = map + start;
+            pcm->frames = (int64_t)(MIN (size - 8 - offset, map_size - start) / (pcm->channels * (pcm->bps / 8)));
+            return 0;
+        }
+        pos += 8 + size + (size & 1);
+    }
+    return -1;
+}
+
+int
+waveform_pcm_open (waveform_pcm_t *pcm, const char *path)
+{
+    memset (pcm, 0, sizeof (waveform_pcm_t));
+    const int fd = open (path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode) || st.st_size < 64 || (uint64_t)st.st_size > SIZE_MAX) {
+        close (fd);
+        return -1;
+    }
+    void *map = mmap (NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    pcm->map = map;
+    pcm->map_size = (size_t)st.st_size;
+
+    const unsigned char *p = map;
+    int res = -1;
+    if ((!memcmp (p, "RIFF", 4) || !memcmp (p, "RF64", 4)) && !memcmp (p + 8, "WAVE", 4)) {
+        res = waveform_pcm_parse_wav (pcm, p, pcm->map_size);
+    }
+    else if (!memcmp (p, w64_riff_guid, sizeof (w64_riff_guid)) && !memcmp (p + 24, "wave", 4)) {
+        res = waveform_pcm_parse_w64 (pcm, p, pcm->map_size);
+    }
+    else if (!memcmp (p, "FORM", 4) && (!memcmp (p + 8, "AIFF", 4) || !memcmp (p + 8, "AIFC", 4))) {
+        res = waveform_pcm_parse_aiff (pcm, p, pcm->map_size);
+    }
+
+    const int supported = pcm->is_float ? pcm->bps == 32 || pcm->bps == 64
+                                        : pcm->bps == 8 || pcm->bps == 16 || pcm->bps == 24 || pcm->bps == 32;
+    if (res != 0
+        || !supported
+        || pcm->channels <= 0
+        || pcm->channels > MAX_CHANNELS
+        || pcm->samplerate <= 0
+        || pcm->frames <= 0) {
+        waveform_pcm_close (pcm);
+        return -1;
+    }
+    madvise (map, pcm->map_size, MADV_SEQUENTIAL);
+    return 0;
+}
+
+void
+waveform_pcm_close (waveform_pcm_t *pcm)
+{
+    if (pcm->map) {
+        munmap (pcm->map, pcm->map_size);
+    }
+    memset (pcm, 0, sizeof (waveform_pcm_t));
+}
+
+void
+waveform_pcm_read (const waveform_pcm_t *pcm, int64_t position, int frames, float *out)
+{
+    const int bytes = pcm->bps / 8;
+    const size_t n = (size_t)frames * pcm->channels;
+    const unsigned char *p = pcm->data + position * pcm->channels * bytes;
+    const int be = pcm->is_bigendian;
+    if (pcm->is_float && bytes == 4) {
+        for (size_t i = 0; i < n; i++, p += 4) {
+            const uint32_t bits = be ? be32 (p) : le32 (p);
+            float value;
+            memcpy (&value, &bits, sizeof (value));
+            out[i] = value;
+        }
+    }
+    else if (pcm->is_float) {
+        for (size_t i = 0; i < n; i++, p += 8) {
+            const uint64_t bits = be ? ((uint64_t)be32 (p) << 32) | be32 (p + 4) : le64 (p);
+            double value;
+            memcpy (&value, &bits, sizeof (value));
+            out[i] = (float)value;
+        }
+    }
+    else if (bytes == 1) {
+        for (size_t i = 0; i < n; i++, p++) {
+            out[i] = (pcm->is_unsigned ? (int)p[0] - 128 : (int8_t)p[0]) / 128.f;
+        }
+    }
+    else if (bytes == 2) {
+        for (size_t i = 0; i < n; i++, p += 2) {
+            out[i] = (int16_t)(be ? be16 (p) : le16 (p)) / 32768.f;
+        }
+    }
+    else if (bytes == 3) {
+        for (size_t i = 0; i < n; i++, p += 3) {
+            const uint32_t bits = be ? ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8)
+                                     : ((uint32_t)p[2] << 24) | (p[1] << 16) | (p[0] << 8);
+            out[i] = (int32_t)bits / 2147483648.f;
+        }
+    }
+    else {
+        for (size_t i = 0; i < n; i++, p += 4) {
+            out[i] = (int32_t)(be ? be32 (p) : le32 (p)) / 2147483648.f;
+        }
+    }
+}
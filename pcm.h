@@ -0,0 +1,66 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    Based on sndfile-tools waveform by Erik de Castro Lopo.
+        waveform.c - v1.04
+        Copyright (C) 2007-2012 Erik de Castro Lopo <erikd@mega-nerd.com>
+        Copyright (C) 2012 Robin Gareus <robin@gareus.org>
+        Copyright (C) 2013 driedfruit <driedfruit@mindloop.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef PCM_HEADER
+#define PCM_HEADER
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Uncompressed WAV (including RF64 and BWF), W64 and AIFF/AIFF-C files,
+// read straight from a memory mapping of the file instead of through a
+// decoder. Anything else is left to the decoder.
+
+typedef struct
+{
+    int channels;
+    int samplerate;
+    // bits per sample of the stored data
+    int bps;
+    int is_float;
+    int is_bigendian;
+    // 8 bit samples stored as unsigned, as in WAV
+    int is_unsigned;
+    int64_t frames;
+    const unsigned char *data;
+
+    void *map;
+    size_t map_size;
+} waveform_pcm_t;
+
+// Returns 0 and fills pcm if path is a file of a supported format.
+int
+waveform_pcm_open (waveform_pcm_t *pcm, const char *path);
+
+void
+waveform_pcm_close (waveform_pcm_t *pcm);
+
+// Converts frames starting at frame position to interleaved floats, which
+// must all be within the file.
+void
+waveform_pcm_read (const waveform_pcm_t *pcm, int64_t position, int frames, float *out);
+
+#endif
@@ -0,0 +1,217 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    Based on sndfile-tools waveform by Erik de Castro Lopo.
+        waveform.c - v1.04
+        Copyright (C) 2007-2012 Erik de Castro Lopo <erikd@mega-nerd.com>
+        Copyright (C) 2012 Robin Gareus <robin@gareus.org>
+        Copyright (C) 2013 driedfruit <driedfruit@mindloop.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+#include <deadbeef/deadbeef.h>
+
+#include "remote.h"
+#include "waveform.h"
+
+#ifndef MIN
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#endif
+#ifndef MAX
+#define MAX(a,b) (((a)>(b))?(a):(b))
+#endif
+
+#define REMOTE_PREFIX "remote-"
+// bytes per read, smaller under a low rate limit so the pauses stay short
+#define REMOTE_BLOCK_MAX (64 * 1024)
+#define REMOTE_BLOCK_MIN (4 * 1024)
+// left free on the cache disk, checked again this often for unknown lengths
+#define REMOTE_FREE_RESERVE (64 * 1024 * 1024)
+#define REMOTE_FREE_INTERVAL (16 * 1024 * 1024)
+
+static double
+waveform_remote_time (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+char *
+waveform_remote_path (const char *dir, const char *uri)
+{
+    // FNV-1a of the uri, the extension is kept for decoders that look at it
+    uint64_t hash = 14695981039346656037ull;
+    for (const unsigned char *c = (const unsigned char *)uri; *c; c++) {
+        hash ^= *c;
+        hash *= 1099511628211ull;
+    }
+    const char *ext = strrchr (uri, '.');
+    if (!ext || strchr (ext, '/') || strlen (ext) > 8) {
+        ext = "";
+    }
+    const size_t len = strlen (dir) + strlen (REMOTE_PREFIX) + 16 + strlen (ext) + 2;
+    char *path = malloc (len);
+    if (path) {
+        snprintf (path, len, "%s/" REMOTE_PREFIX "%016llx%s", dir, (unsigned long long)hash, ext);
+    }
+    return path;
+}
+
+// Whether size more bytes fit on the disk of fd with the reserve to spare.
+static int
+waveform_remote_fits (int fd, int64_t size)
+{
+    struct statvfs st;
+    if (fstatvfs (fd, &st) != 0) {
+        return 1;
+    }
+    return (int64_t)st.f_bavail * (int64_t)st.f_frsize >= size + REMOTE_FREE_RESERVE;
+}
+
+static int
+waveform_remote_write (int fd, const char *buffer, size_t size)
+{
+    while (size > 0) {
+        const ssize_t n = write (fd, buffer, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        buffer += n;
+        size -= n;
+    }
+    return 0;
+}
+
+int
+waveform_remote_fetch (const char *uri, const char *path, int64_t rate, int64_t max_size, waveform_remote_cancel_func cancelled, void *ctx)
+{
+    DB_FILE *f = deadbeef->fopen (uri);
+    if (!f) {
+        trace ("waveform: failed to open %s\n", uri);
+        return -1;
+    }
+    int fd = open (path, O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) {
+        deadbeef->fclose (f);
+        return -1;
+    }
+
+    const int64_t length = deadbeef->fgetlength (f);
+    struct stat st;
+    int64_t offset = fstat (fd, &st) == 0 ? st.st_size : 0;
+    // without a known length a partial copy can't be checked, start over
+    if (length <= 0 || offset > length) {
+        offset = 0;
+    }
+    if ((max_size > 0 && length > max_size) || !waveform_remote_fits (fd, MAX (length - offset, 0))) {
+        trace ("waveform: not copying %s of %lld bytes\n", uri, (long long)length);
+        close (fd);
+        unlink (path);
+        deadbeef->fclose (f);
+        return REMOTE_TOO_LARGE;
+    }
+    if (offset > 0 && deadbeef->fseek (f, offset, SEEK_SET) != 0) {
+        offset = 0;
+    }
+    const size_t block = rate > 0 ? MIN (MAX (rate / 8, REMOTE_BLOCK_MIN), REMOTE_BLOCK_MAX) : REMOTE_BLOCK_MAX;
+    char *buffer = malloc (block);
+    int result = -1;
+    if (!buffer || ftruncate (fd, offset) != 0 || lseek (fd, offset, SEEK_SET) != offset) {
+        goto out;
+    }
+    trace ("waveform: fetching %s from %lld of %lld bytes\n", uri, (long long)offset, (long long)length);
+
+    const double start = waveform_remote_time ();
+    int64_t fetched = 0;
+    for (;;) {
+        if (cancelled && cancelled (ctx)) {
+            break;
+        }
+        const size_t n = deadbeef->fread (buffer, 1, block, f);
+        if (n == 0) {
+            // a short copy is kept and continued next time, one of unknown
+            // length may have been cut short as well
+            result = length <= 0 ? 1 : offset == length ? 0 : -1;
+            break;
+        }
+        if (waveform_remote_write (fd, buffer, n) != 0) {
+            break;
+        }
+        offset += n;
+        fetched += n;
+        // a source of unknown length is only checked while it comes in
+        if (length <= 0 && ((max_size > 0 && offset > max_size)
+                    || (offset / REMOTE_FREE_INTERVAL != (offset - n) / REMOTE_FREE_INTERVAL && !waveform_remote_fits (fd, 0)))) {
+            result = REMOTE_TOO_LARGE;
+            break;
+        }
+        if (rate > 0) {
+            const double ahead = (double)fetched / rate - (waveform_remote_time () - start);
+            if (ahead > 0) {
+                usleep ((useconds_t)(ahead * 1e6));
+            }
+        }
+    }
+
+out:
+    free (buffer);
+    if (close (fd) != 0 && result != REMOTE_TOO_LARGE) {
+        result = -1;
+    }
+    if (result == REMOTE_TOO_LARGE) {
+        unlink (path);
+    }
+    deadbeef->fclose (f);
+    return result;
+}
+
+void
+waveform_remote_cleanup (const char *dir)
+{
+    DIR *d = opendir (dir);
+    if (!d) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir (d))) {
+        if (strncmp (entry->d_name, REMOTE_PREFIX, strlen (REMOTE_PREFIX))) {
+            continue;
+        }
+        char path[PATH_MAX];
+        if (snprintf (path, sizeof (path), "%s/%s", dir, entry->d_name) < (int)sizeof (path)) {
+            unlink (path);
+        }
+    }
+    closedir (d);
+}
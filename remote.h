@@ -0,0 +1,61 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    Based on sndfile-tools waveform by Erik de Castro Lopo.
+        waveform.c - v1.04
+        Copyright (C) 2007-2012 Erik de Castro Lopo <erikd@mega-nerd.com>
+        Copyright (C) 2012 Robin Gareus <robin@gareus.org>
+        Copyright (C) 2013 driedfruit <driedfruit@mindloop.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef REMOTE_HEADER
+#define REMOTE_HEADER
+
+#include <stdint.h>
+
+// Local copies of files only reachable through a VFS plugin (HTTP, SMB,
+// archives, ...), so the decoders can seek in them without going back to
+// the network.
+
+// polled between reads, non-zero stops the download
+typedef int (*waveform_remote_cancel_func) (void *ctx);
+
+// Name of the local copy of uri in dir. The caller frees it.
+char *
+waveform_remote_path (const char *dir, const char *uri);
+
+#define REMOTE_TOO_LARGE (-2)
+
+// Downloads uri to path at no more than rate bytes per second, 0 for no
+// limit. A partial copy left at path by an earlier attempt is continued
+// with a seek, which the HTTP plugin turns into a range request; that is
+// the only range request made, decoders never seek on the network copy.
+// Returns 0 once path holds the whole file, 1 if the source has no known
+// length and the copy may be truncated. Returns REMOTE_TOO_LARGE and
+// removes the copy if the file is larger than max_size bytes (0 for no
+// limit) or wouldn't fit on the disk; otherwise -1 and the partial copy
+// is kept.
+int
+waveform_remote_fetch (const char *uri, const char *path, int64_t rate, int64_t max_size, waveform_remote_cancel_func cancelled, void *ctx);
+
+// Removes the copies left in dir.
+void
+waveform_remote_cleanup (const char *dir);
+
+#endif
@@ -20,6 +20,7 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/param.h>
 #include <math.h>
 #include <assert.h>
@@ -27,12 +28,21 @@
 
 #include "render.h"
 #include "waveform.h"
+#include "meter.h"
 #include "config.h"
 
 #define LINE_WIDTH_DEFAULT (1.0)
 #define LINE_WIDTH_BARS (1.0)
-#define VALUES_PER_SAMPLE (3)
 #define W_COLOR(X) (X)->r, (X)->g, (X)->b, (X)->a
+// band levels are raised before they are compared, music has far more
+// energy in the lows than in the highs
+#define BAND_GAIN_LOW (1.0)
+#define BAND_GAIN_MID (2.0)
+#define BAND_GAIN_HIGH (4.0)
+// share of the waveform color in a band color
+#define BAND_BASE_MIX (0.25)
+// brightness of the RMS part relative to the peaks
+#define BAND_RMS_SHADE (0.6)
 
 typedef struct
 {
@@ -132,26 +142,105 @@ waveform_data_render_build_sample (wavedata_t *wave_data,
 
 waveform_data_render_t *
 waveform_render_data_build (wavedata_t *wave_data, int width, bool downmix_mono)
+{
+    return waveform_render_data_build_range (wave_data, width, 0, width, downmix_mono, NULL, 0);
+}
+
+// Band levels of the feature columns shown at x, merged as RMS.
+static void
+waveform_render_data_bands (waveform_sample_t *sample, const short *features, int columns, int x, int width)
+{
+    const int from = (int)MIN ((int64_t)x * columns / width, columns - 1);
+    const int to = (int)MAX ((int64_t)(x + 1) * columns / width, from + 1);
+    double low = 0.0;
+    double mid = 0.0;
+    double high = 0.0;
+    for (const short *f = features + from * METER_VALUES; f < features + to * METER_VALUES; f += METER_VALUES) {
+        low += (double)f[METER_BAND_LOW] * f[METER_BAND_LOW];
+        mid += (double)f[METER_BAND_MID] * f[METER_BAND_MID];
+        high += (double)f[METER_BAND_HIGH] * f[METER_BAND_HIGH];
+    }
+    sample->low = sqrt (low / (to - from)) / 1000;
+    sample->mid = sqrt (mid / (to - from)) / 1000;
+    sample->high = sqrt (high / (to - from)) / 1000;
+}
+
+static bool
+waveform_render_data_has_mix (const short *features, int columns)
+{
+    for (int c = 0; c < columns; c++) {
+        if (features[c * METER_VALUES + METER_MONO] != METER_MIX_NONE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The derived channel at offset lane of the feature columns shown at x.
+static void
+waveform_render_data_derived (waveform_sample_t *sample, const short *features, int columns, int lane, int x, int width)
+{
+    const int from = (int)MIN ((int64_t)x * columns / width, columns - 1);
+    const int to = (int)MAX ((int64_t)(x + 1) * columns / width, from + 1);
+    float max = -1.0;
+    float min = 1.0;
+    float rms = 0.0;
+    int counter = 0;
+    for (const short *f = features + from * METER_VALUES + lane; f < features + to * METER_VALUES; f += METER_VALUES) {
+        if (f[0] == METER_MIX_NONE) {
+            continue;
+        }
+        max = MAX (max, (float)f[0]/1000);
+        min = MIN (min, (float)f[1]/1000);
+        rms += ((float)f[2]/1000) * ((float)f[2]/1000);
+        counter++;
+    }
+    sample->max = counter ? max : 0.0;
+    sample->min = counter ? min : 0.0;
+    sample->rms = counter ? sqrt (rms / counter) : 0.0;
+}
+
+waveform_data_render_t *
+waveform_render_data_build_range (wavedata_t *wave_data, int width, int x_first, int x_last, bool downmix_mono, const short *features, int feature_columns)
 {
     const int channels_data = wave_data->channels;
-    if (channels_data <= 0) {
+    if (channels_data <= 0 || width <= 0) {
+        return NULL;
+    }
+    x_first = MAX (x_first, 0);
+    x_last = MIN (x_last, width);
+    if (x_first >= x_last) {
         return NULL;
     }
 
-    const int channels_render = CONFIG_MIX_TO_MONO ? 1 : channels_data;
+    // mono and mid/side are a read of the channels the analysis derived,
+    // without those mono is folded from the channels and mid/side not shown
+    const bool derived = (CONFIG_MID_SIDE || CONFIG_MIX_TO_MONO)
+        && features
+        && feature_columns > 0
+        && waveform_render_data_has_mix (features, feature_columns);
+    const int channels_render = derived ? (CONFIG_MID_SIDE ? 2 : 1) : CONFIG_MIX_TO_MONO ? 1 : channels_data;
     const int sample_size = VALUES_PER_SAMPLE * channels_data;
     const double num_samples_per_x = wave_data->data_len / (double)(width * sample_size);
 
-    waveform_data_render_t *w_render_ctx = waveform_data_render_new (channels_render, width);
+    waveform_data_render_t *w_render_ctx = waveform_data_render_new (channels_render, x_last - x_first);
 
     for (int ch = 0; ch < w_render_ctx->num_channels; ch++) {
         waveform_sample_t *samples = w_render_ctx->samples[ch];
 
-        double d_start = 0.;
+        double d_start = x_first > 0 ? MAX (x_first * num_samples_per_x, 1.) : 0.;
 
-        for (int x = 0; x < width; x++) {
+        for (int x = x_first; x < x_last; x++) {
             const double d_end = MAX ((x + 1) * num_samples_per_x, 1.);
-            waveform_sample_t *sample = &samples[x];
+            waveform_sample_t *sample = &samples[x - x_first];
+
+            if (derived) {
+                const int lane = !CONFIG_MID_SIDE ? METER_MONO : ch == 0 ? METER_MID : METER_SIDE;
+                waveform_render_data_derived (sample, features, feature_columns, lane, x, width);
+                waveform_render_data_bands (sample, features, feature_columns, x, width);
+                d_start = d_end;
+                continue;
+            }
 
             int counter = 0;
             if (CONFIG_MIX_TO_MONO) {
@@ -175,6 +264,9 @@ waveform_render_data_build (wavedata_t *wave_data, int width, bool downmix_mono)
 
             sample->rms /= counter;
             sample->rms = sqrt (sample->rms);
+            if (features && feature_columns > 0) {
+                waveform_render_data_bands (sample, features, feature_columns, x, width);
+            }
 
             d_start = d_end;
         }
@@ -257,9 +349,9 @@ waveform_render_samples_loop_reverse (cairo_t *cr_ctx,
 
     const int width_i = floor (width) - 1;
 
-    for (int x = width_i; x >= x_start; x--) {
+    for (int x = width_i; x >= 0; x--) {
         waveform_sample_t *sample = &samples[x];
-        waveform_point_t point = {x, y_start};
+        waveform_point_t point = {x_start + x, y_start};
 
         (*render_sample)(cr_ctx, sample, &point, y_scale_1, y_scale_2);
     }
@@ -337,6 +429,41 @@ waveform_render_bars_sample_rms (cairo_t *cr_ctx,
 
 }
 
+// Horizontal gradient with the spectral balance of each sample, lows red,
+// mids green and highs blue, or NULL if no sample has band levels.
+static cairo_pattern_t *
+waveform_render_band_pattern_get (waveform_sample_t *samples,
+                                  color_t *base,
+                                  double shade,
+                                  waveform_rect_t *rect)
+{
+    if (!CONFIG_BAND_COLORS || rect->width <= 0) {
+        return NULL;
+    }
+    cairo_pattern_t *pat = NULL;
+    const int width_i = floor (rect->width);
+    for (int x = 0; x < width_i; x++) {
+        const waveform_sample_t *sample = &samples[x];
+        const double low = sample->low * BAND_GAIN_LOW;
+        const double mid = sample->mid * BAND_GAIN_MID;
+        const double high = sample->high * BAND_GAIN_HIGH;
+        const double top = MAX (low, MAX (mid, high));
+        if (top <= 0.0) {
+            continue;
+        }
+        if (!pat) {
+            pat = cairo_pattern_create_linear (rect->x, 0, rect->x + rect->width, 0);
+        }
+        cairo_pattern_add_color_stop_rgba (pat,
+                                           (x + 0.5) / rect->width,
+                                           shade * ((1.0 - BAND_BASE_MIX) * low / top + BAND_BASE_MIX * base->r),
+                                           shade * ((1.0 - BAND_BASE_MIX) * mid / top + BAND_BASE_MIX * base->g),
+                                           shade * ((1.0 - BAND_BASE_MIX) * high / top + BAND_BASE_MIX * base->b),
+                                           base->a);
+    }
+    return pat;
+}
+
 static cairo_pattern_t *
 waveform_render_soundcloud_pattern_get (cairo_t *cr_ctx,
                                         waveform_colors_t *color,
@@ -359,6 +486,7 @@ static void
 waveform_render_wave_bar_values (cairo_t *cr_ctx,
                                  waveform_sample_t *samples,
                                  waveform_colors_t *color,
+                                 cairo_pattern_t *bands,
                                  int type,
                                  waveform_rect_t *rect)
 {
@@ -390,7 +518,10 @@ waveform_render_wave_bar_values (cairo_t *cr_ctx,
     }
 
     cairo_pattern_t *lin_pat = NULL;
-    if (CONFIG_SOUNDCLOUD_STYLE) {
+    if (bands) {
+        cairo_set_source (cr_ctx, bands);
+    }
+    else if (CONFIG_SOUNDCLOUD_STYLE) {
         waveform_line_t vec_pat = {
             .x1 = x,
             .y1 = y,
@@ -429,20 +560,30 @@ waveform_draw_wave_bars (waveform_sample_t *samples,
     cairo_set_source_rgba (cr_ctx, W_COLOR (&colors->fg));
 
     // draw min/max values
+    cairo_pattern_t *bands = waveform_render_band_pattern_get (samples, &colors->fg, 1.0, rect);
     waveform_render_wave_bar_values (cr_ctx,
                                      samples,
                                      colors,
+                                     bands,
                                      SAMPLE_MAX,
                                      rect);
 
     if (CONFIG_DISPLAY_RMS) {
         // draw rms values
+        cairo_pattern_t *bands_rms = bands ? waveform_render_band_pattern_get (samples, &colors->fg, BAND_RMS_SHADE, rect) : NULL;
         cairo_set_source_rgba (cr_ctx, W_COLOR (&colors->rms));
         waveform_render_wave_bar_values (cr_ctx,
                                          samples,
                                          colors,
+                                         bands_rms,
                                          SAMPLE_RMS_MAX,
                                          rect);
+        if (bands_rms) {
+            cairo_pattern_destroy (bands_rms);
+        }
+    }
+    if (bands) {
+        cairo_pattern_destroy (bands);
     }
 
     return;
@@ -521,6 +662,7 @@ static void
 waveform_render_wave_default_values (cairo_t *cr_ctx,
                                      waveform_sample_t *samples,
                                      waveform_colors_t *color,
+                                     cairo_pattern_t *bands,
                                      int type,
                                      waveform_rect_t *rect)
 {
@@ -553,7 +695,10 @@ waveform_render_wave_default_values (cairo_t *cr_ctx,
     }
 
     cairo_pattern_t *lin_pat = NULL;
-    if (CONFIG_SOUNDCLOUD_STYLE) {
+    if (bands) {
+        cairo_set_source (cr_ctx, bands);
+    }
+    else if (CONFIG_SOUNDCLOUD_STYLE) {
         waveform_line_t vec_pat = {
             .x1 = x,
             .y1 = y,
@@ -608,20 +753,30 @@ waveform_draw_wave_default (waveform_sample_t *samples,
     cairo_set_antialias (cr_ctx, CAIRO_ANTIALIAS_DEFAULT);
     cairo_set_source_rgba (cr_ctx, W_COLOR (&colors->fg));
 
+    cairo_pattern_t *bands = waveform_render_band_pattern_get (samples, &colors->fg, 1.0, rect);
     waveform_render_wave_default_values (cr_ctx,
                                          samples,
                                          colors,
+                                         bands,
                                          SAMPLE_MIN_MAX,
                                          rect);
 
     if (CONFIG_DISPLAY_RMS) {
+        cairo_pattern_t *bands_rms = bands ? waveform_render_band_pattern_get (samples, &colors->fg, BAND_RMS_SHADE, rect) : NULL;
         cairo_set_source_rgba (cr_ctx, W_COLOR (&colors->rms));
 
         waveform_render_wave_default_values (cr_ctx,
                                              samples,
                                              colors,
+                                             bands_rms,
                                              SAMPLE_RMS_MIN_MAX,
                                              rect);
+        if (bands_rms) {
+            cairo_pattern_destroy (bands_rms);
+        }
+    }
+    if (bands) {
+        cairo_pattern_destroy (bands);
     }
 
     return;
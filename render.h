@@ -27,6 +27,11 @@ typedef struct {
     float max;
     float min;
     float rms;
+    // level of the bands below 200 Hz, up to 2 kHz and above, all 0 if
+    // unknown
+    float low;
+    float mid;
+    float high;
 } waveform_sample_t;
 
 typedef struct {
@@ -42,6 +47,12 @@ waveform_data_render_free (waveform_data_render_t *w_render_ctx);
 waveform_data_render_t *
 waveform_render_data_build (wavedata_t *wave_data, int width, bool downmix_mono);
 
+// Only the samples for x_first to x_last - 1 of a render width wide,
+// samples[ch][0] being the one at x_first. The band levels are taken from
+// features, METER_VALUES per column, if given.
+waveform_data_render_t *
+waveform_render_data_build_range (wavedata_t *wave_data, int width, int x_first, int x_last, bool downmix_mono, const short *features, int feature_columns);
+
 void
 waveform_draw_wave_default (waveform_sample_t *samples,
                             waveform_colors_t *colors,
@@ -0,0 +1,455 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    Based on sndfile-tools waveform by Erik de Castro Lopo.
+        waveform.c - v1.04
+        Copyright (C) 2007-2012 Erik de Castro Lopo <erikd@mega-nerd.com>
+        Copyright (C) 2012 Robin Gareus <robin@gareus.org>
+        Copyright (C) 2013 driedfruit <driedfruit@mindloop.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <deadbeef/deadbeef.h>
+
+#include "tap.h"
+#include "waveform.h"
+
+#ifndef MIN
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#endif
+#ifndef MAX
+#define MAX(a,b) (((a)>(b))?(a):(b))
+#endif
+
+static uintptr_t mutex = 0;
+static uintptr_t cond = 0;
+// guards listening and the calls that change it, the listener itself only
+// takes mutex
+static uintptr_t listen_mutex = 0;
+static int listening;
+static int num_columns;
+static int stream_window;
+// tracks with a duration are reduced too, otherwise only streams are
+static int tap_tracks;
+// network files with a duration are analyzed as tracks
+static int remote_files;
+
+// state of the track being played
+static DB_playItem_t *track;
+static int channels;
+static int samplerate;
+static int64_t total_frames;
+static short *columns;
+static char *column_done;
+// frame the next block of PCM is expected to start at, -1 if unknown
+static int64_t next_frame = -1;
+// counts jumps of the play position, track changes and wakeups, see
+// waveform_tap_wait; wake_frame is the earliest frame a waiter waits for
+static unsigned events;
+static int64_t wake_frame = -1;
+
+// Streams have no usable duration, their columns go to a ring buffer that
+// covers the last stream_window seconds instead. stream_head counts all
+// columns written so far.
+static int stream;
+static int64_t stream_column_frames;
+static int64_t stream_head;
+
+// column being accumulated, only stored if it was seen from its first frame
+static int acc_column = -1;
+static int acc_complete;
+static int64_t acc_frames;
+static float acc_max[MAX_CHANNELS];
+static float acc_min[MAX_CHANNELS];
+static float acc_sum[MAX_CHANNELS];
+
+static int64_t
+waveform_tap_column_start (int column)
+{
+    return (int64_t)column * total_frames / num_columns;
+}
+
+static int
+waveform_tap_column (int64_t frame)
+{
+    int column = (int)(frame * num_columns / total_frames);
+    while (column > 0 && waveform_tap_column_start (column) > frame) {
+        column--;
+    }
+    while (column + 1 < num_columns && waveform_tap_column_start (column + 1) <= frame) {
+        column++;
+    }
+    return column;
+}
+
+int
+waveform_tap_is_stream (DB_playItem_t *it, int remote)
+{
+    deadbeef->pl_lock ();
+    const char *uri = deadbeef->pl_find_meta_raw (it, ":URI");
+    const int stream = !uri || (!remote && !deadbeef->is_local_file (uri)) || deadbeef->pl_get_item_duration (it) <= 0;
+    deadbeef->pl_unlock ();
+    return stream;
+}
+
+static void
+waveform_tap_reset (DB_playItem_t *it, float duration, const ddb_waveformat_t *fmt)
+{
+    if (track) {
+        deadbeef->pl_item_unref (track);
+    }
+    deadbeef->pl_item_ref (it);
+    track = it;
+    channels = fmt->channels;
+    samplerate = fmt->samplerate;
+    total_frames = 0;
+    stream = duration <= 0 || waveform_tap_is_stream (it, remote_files);
+
+    if (channels > 0 && channels <= MAX_CHANNELS) {
+        if (stream) {
+            stream_column_frames = MAX (1, (int64_t)stream_window * samplerate / num_columns);
+        }
+        else {
+            total_frames = (int64_t)((double)duration * samplerate);
+        }
+    }
+    else {
+        stream = 0;
+    }
+    memset (column_done, 0, num_columns);
+    stream_head = 0;
+    next_frame = -1;
+    acc_column = -1;
+    acc_frames = 0;
+    events++;
+    deadbeef->cond_broadcast (cond);
+}
+
+static void
+waveform_tap_accumulate_begin (void)
+{
+    acc_frames = 0;
+    for (int ch = 0; ch < channels; ch++) {
+        acc_max[ch] = -1.0;
+        acc_min[ch] = 1.0;
+        acc_sum[ch] = 0.0;
+    }
+}
+
+static void
+waveform_tap_accumulate (const float *data, int frames)
+{
+    for (int ch = 0; ch < channels; ch++) {
+        for (int sample = 0; sample < frames; sample++) {
+            const float sample_val = data[sample * channels + ch];
+            acc_max[ch] = MAX (acc_max[ch], sample_val);
+            acc_min[ch] = MIN (acc_min[ch], sample_val);
+            acc_sum[ch] += sample_val * sample_val;
+        }
+    }
+    acc_frames += frames;
+}
+
+static void
+waveform_tap_store (void)
+{
+    if (!acc_complete || acc_frames <= 0) {
+        return;
+    }
+    short *values = columns + acc_column * channels * VALUES_PER_SAMPLE;
+    for (int ch = 0; ch < channels; ch++) {
+        values[0] = (short)(acc_max[ch]*1000);
+        values[1] = (short)(acc_min[ch]*1000);
+        values[2] = (short)(sqrt (acc_sum[ch] / acc_frames)*1000);
+        values += VALUES_PER_SAMPLE;
+    }
+    column_done[acc_column] = 1;
+}
+
+static void
+waveform_tap_stream_feed (ddb_audio_data_t *data)
+{
+    int i = 0;
+    while (i < data->nframes) {
+        if (acc_frames == 0) {
+            waveform_tap_accumulate_begin ();
+        }
+        const int n = (int)MIN (data->nframes - i, stream_column_frames - acc_frames);
+        waveform_tap_accumulate (data->data + i * channels, n);
+        i += n;
+        if (acc_frames == stream_column_frames) {
+            acc_column = (int)(stream_head % num_columns);
+            acc_complete = 1;
+            waveform_tap_store ();
+            stream_head++;
+            acc_frames = 0;
+        }
+    }
+}
+
+static void
+waveform_tap_callback (void *ctx, ddb_audio_data_t *data)
+{
+    DB_playItem_t *it = deadbeef->streamer_get_playing_track ();
+    if (!it) {
+        return;
+    }
+    const float duration = deadbeef->pl_get_item_duration (it);
+    const int64_t playpos = llround ((double)deadbeef->streamer_get_playpos () * data->fmt->samplerate);
+
+    deadbeef->mutex_lock (mutex);
+    if (!columns) {
+        goto out;
+    }
+    if (it != track || data->fmt->channels != channels || data->fmt->samplerate != samplerate) {
+        waveform_tap_reset (it, duration, data->fmt);
+    }
+    if (stream) {
+        waveform_tap_stream_feed (data);
+        goto out;
+    }
+    if (!tap_tracks || total_frames <= 0) {
+        goto out;
+    }
+
+    // the listener doesn't say where the data belongs, the play position is
+    // only trusted after a jump of more than half a second. A track that was
+    // just started is assumed to start at its first frame.
+    if (next_frame < 0 && playpos < samplerate / 2) {
+        next_frame = 0;
+    }
+    else if (next_frame < 0 || llabs (playpos - next_frame) > samplerate / 2) {
+        next_frame = playpos;
+        acc_column = -1;
+        events++;
+        deadbeef->cond_broadcast (cond);
+    }
+
+    int64_t pos = next_frame;
+    int i = 0;
+    while (i < data->nframes && pos < total_frames) {
+        const int column = waveform_tap_column (pos);
+        if (column != acc_column) {
+            acc_column = column;
+            acc_complete = pos == waveform_tap_column_start (column);
+            waveform_tap_accumulate_begin ();
+        }
+        const int64_t column_end = column + 1 < num_columns ? waveform_tap_column_start (column + 1) : total_frames;
+        const int n = (int)MIN (data->nframes - i, column_end - pos);
+        waveform_tap_accumulate (data->data + i * channels, n);
+        i += n;
+        pos += n;
+        if (pos == column_end) {
+            waveform_tap_store ();
+            acc_column = -1;
+        }
+    }
+    next_frame += data->nframes;
+    if (wake_frame >= 0 && next_frame >= wake_frame) {
+        wake_frame = -1;
+        deadbeef->cond_broadcast (cond);
+    }
+
+out:
+    deadbeef->mutex_unlock (mutex);
+    deadbeef->pl_item_unref (it);
+}
+
+void
+waveform_tap_init (void)
+{
+    mutex = deadbeef->mutex_create ();
+    cond = deadbeef->cond_create ();
+    listen_mutex = deadbeef->mutex_create ();
+}
+
+void
+waveform_tap_free (void)
+{
+    waveform_tap_stop ();
+    if (!mutex) {
+        return;
+    }
+    deadbeef->cond_free (cond);
+    deadbeef->mutex_free (mutex);
+    deadbeef->mutex_free (listen_mutex);
+    cond = 0;
+    mutex = 0;
+    listen_mutex = 0;
+}
+
+void
+waveform_tap_start (int columns_wanted, int stream_seconds, int tracks, int remote)
+{
+    if (!mutex) {
+        return;
+    }
+    deadbeef->mutex_lock (mutex);
+    if ((stream_seconds != stream_window || remote != remote_files) && track) {
+        deadbeef->pl_item_unref (track);
+        track = NULL;
+    }
+    stream_window = stream_seconds;
+    tap_tracks = tracks;
+    remote_files = remote;
+    if (columns_wanted != num_columns) {
+        free (columns);
+        free (column_done);
+        num_columns = columns_wanted;
+        columns = calloc (num_columns * MAX_CHANNELS * VALUES_PER_SAMPLE, sizeof (short));
+        column_done = calloc (num_columns, 1);
+        if (!columns || !column_done) {
+            free (columns);
+            free (column_done);
+            columns = NULL;
+            column_done = NULL;
+            num_columns = 0;
+        }
+        if (track) {
+            deadbeef->pl_item_unref (track);
+            track = NULL;
+        }
+    }
+    deadbeef->mutex_unlock (mutex);
+
+    deadbeef->mutex_lock (listen_mutex);
+    if (!listening) {
+        deadbeef->vis_waveform_listen (&listening, waveform_tap_callback);
+        listening = 1;
+    }
+    deadbeef->mutex_unlock (listen_mutex);
+}
+
+void
+waveform_tap_stop (void)
+{
+    if (!mutex) {
+        return;
+    }
+    deadbeef->mutex_lock (listen_mutex);
+    if (listening) {
+        deadbeef->vis_waveform_unlisten (&listening);
+        listening = 0;
+    }
+    deadbeef->mutex_unlock (listen_mutex);
+    deadbeef->mutex_lock (mutex);
+    if (track) {
+        deadbeef->pl_item_unref (track);
+        track = NULL;
+    }
+    free (columns);
+    free (column_done);
+    columns = NULL;
+    column_done = NULL;
+    num_columns = 0;
+    events++;
+    deadbeef->cond_broadcast (cond);
+    deadbeef->mutex_unlock (mutex);
+}
+
+void
+waveform_tap_wake (void)
+{
+    if (!mutex) {
+        return;
+    }
+    deadbeef->mutex_lock (mutex);
+    events++;
+    deadbeef->cond_broadcast (cond);
+    deadbeef->mutex_unlock (mutex);
+}
+
+int
+waveform_tap_wait (DB_playItem_t *it, float seconds, unsigned *seen)
+{
+    if (!mutex) {
+        return -1;
+    }
+    deadbeef->mutex_lock (mutex);
+    // the listener gets the PCM before it is heard, the play position
+    // itself is checked
+    while (columns && tap_tracks && *seen == events
+           && (it != track || deadbeef->streamer_get_playpos () < seconds)) {
+        const int64_t frame = it == track ? (int64_t)((double)seconds * samplerate) : -1;
+        if (frame >= 0 && (wake_frame < 0 || frame < wake_frame)) {
+            wake_frame = frame;
+        }
+        deadbeef->cond_wait (cond, mutex);
+    }
+    const int result = columns && tap_tracks ? 0 : -1;
+    *seen = events;
+    deadbeef->mutex_unlock (mutex);
+    return result;
+}
+
+int
+waveform_tap_collect (DB_playItem_t *it, int columns_wanted, int channels_wanted, short *data, char *done, int *first, int *last)
+{
+    int n = 0;
+    if (!mutex) {
+        return 0;
+    }
+    deadbeef->mutex_lock (mutex);
+    if (it == track && !stream && columns && columns_wanted == num_columns && channels_wanted == channels) {
+        const int column_size = channels * VALUES_PER_SAMPLE;
+        for (int c = 0; c < num_columns; c++) {
+            if (column_done[c] && !done[c]) {
+                memcpy (data + c * column_size, columns + c * column_size, column_size * sizeof (short));
+                done[c] = 1;
+                *first = MIN (*first, c);
+                *last = MAX (*last, c + 1);
+                n++;
+            }
+        }
+    }
+    deadbeef->mutex_unlock (mutex);
+    return n;
+}
+
+int
+waveform_tap_stream_read (DB_playItem_t *it, int64_t *head, short *data, int columns_wanted, int *channels_out)
+{
+    int n = -1;
+    if (!mutex) {
+        return -1;
+    }
+    deadbeef->mutex_lock (mutex);
+    if (it == track && stream && columns && columns_wanted == num_columns) {
+        n = 0;
+        if (*head != stream_head) {
+            // oldest column first, a ring that isn't full yet is padded on
+            // the left so the newest column is always on the right
+            const int filled = (int)MIN (stream_head, num_columns);
+            const int column_size = channels * VALUES_PER_SAMPLE;
+            memset (data, 0, (num_columns - filled) * column_size * sizeof (short));
+            for (int c = 0; c < filled; c++) {
+                const int src = (int)((stream_head - filled + c) % num_columns);
+                memcpy (data + (num_columns - filled + c) * column_size, columns + src * column_size, column_size * sizeof (short));
+            }
+            *head = stream_head;
+            *channels_out = channels;
+            n = num_columns;
+        }
+    }
+    deadbeef->mutex_unlock (mutex);
+    return n;
+}
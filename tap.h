@@ -0,0 +1,80 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    Based on sndfile-tools waveform by Erik de Castro Lopo.
+        waveform.c - v1.04
+        Copyright (C) 2007-2012 Erik de Castro Lopo <erikd@mega-nerd.com>
+        Copyright (C) 2012 Robin Gareus <robin@gareus.org>
+        Copyright (C) 2013 driedfruit <driedfruit@mindloop.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef TAP_HEADER
+#define TAP_HEADER
+
+#include <deadbeef/deadbeef.h>
+
+// Reduces the PCM sent to visualization listeners into columns of the
+// playing track, so played parts need not be decoded a second time. Streams
+// get a ring buffer of columns covering the last stream_seconds instead.
+// Other tracks are skipped unless tracks is set. With remote set, network
+// files with a duration count as tracks, as they are analyzed from a local
+// copy.
+
+// waveform_tap_init and waveform_tap_free run at plugin start and stop.
+void
+waveform_tap_init (void);
+
+void
+waveform_tap_free (void);
+
+void
+waveform_tap_start (int num_columns, int stream_seconds, int tracks, int remote);
+
+void
+waveform_tap_stop (void);
+
+// Blocks until the track plays past seconds, or the play position jumps,
+// the played track changes or waveform_tap_wake is called. Changes since
+// seen, which is updated, return right away. Returns -1 if the tap doesn't
+// collect columns of tracks.
+int
+waveform_tap_wait (DB_playItem_t *it, float seconds, unsigned *seen);
+
+void
+waveform_tap_wake (void);
+
+// Whether it plays as a stream: it has no duration, or it is a network file
+// and remote isn't set.
+int
+waveform_tap_is_stream (DB_playItem_t *it, int remote);
+
+// Copies columns of the given track that were completely played and are not
+// yet set in done, widening first to last - 1 to include them. Returns the
+// number of columns copied.
+int
+waveform_tap_collect (DB_playItem_t *it, int num_columns, int channels, short *data, char *done, int *first, int *last);
+
+// Copies the ring of the given stream into data, oldest column first, if
+// anything was added since head. Returns num_columns and updates head and
+// channels if data was copied, 0 if nothing changed and -1 if the tap has no
+// data for it.
+int
+waveform_tap_stream_read (DB_playItem_t *it, int64_t *head, short *data, int num_columns, int *channels);
+
+#endif
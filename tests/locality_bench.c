@@ -0,0 +1,165 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+// Reads a set of files in the order they were queued and again in the order
+// the queue hands them out with locality keys, with the page cache dropped
+// before each pass. Run it on the disk to be measured:
+//
+//     make bench BENCH_DIR=/mnt/disk/tmp
+//
+// The files are written in name order and queued in a shuffled one, so on a
+// disk that allocates in write order the queue should restore name order.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <deadbeef/deadbeef.h>
+
+#include "../utils.h"
+#include "../throttle.h"
+#include "../worker.h"
+#include "stub.h"
+
+#define BENCH_FILES (600)
+#define BENCH_FILE_SIZE (512 * 1024)
+#define BENCH_PASSES (3)
+
+static char paths[BENCH_FILES][PATH_MAX];
+static char queued[BENCH_FILES][PATH_MAX];
+static char taken[BENCH_FILES][PATH_MAX];
+
+static double
+bench_time (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+bench_evict (void)
+{
+    for (int i = 0; i < BENCH_FILES; i++) {
+        int fd = open (paths[i], O_RDONLY);
+        if (fd >= 0) {
+            fdatasync (fd);
+            posix_fadvise (fd, 0, 0, POSIX_FADV_DONTNEED);
+            close (fd);
+        }
+    }
+}
+
+// Returns the seconds taken, distance is set to the bytes between the end
+// of one file and the start of the next, as far as the keys tell.
+static double
+bench_read (char order[][PATH_MAX], double *distance)
+{
+    static char buf[64 * 1024];
+    bench_evict ();
+    *distance = 0;
+    uint64_t last = 0;
+    const double start = bench_time ();
+    for (int i = 0; i < BENCH_FILES; i++) {
+        const uint64_t locality = waveform_locality (order[i]);
+        if (i > 0) {
+            *distance += locality > last ? locality - last : last - locality;
+        }
+        last = locality + BENCH_FILE_SIZE;
+        int fd = open (order[i], O_RDONLY);
+        if (fd < 0) {
+            continue;
+        }
+        while (read (fd, buf, sizeof (buf)) > 0) {
+        }
+        close (fd);
+    }
+    return bench_time () - start;
+}
+
+int
+main (int argc, char **argv)
+{
+    const char *dir = argc > 1 ? argv[1] : "/tmp";
+    stub_init ();
+
+    char *data = malloc (BENCH_FILE_SIZE);
+    if (!data) {
+        return 1;
+    }
+    memset (data, 7, BENCH_FILE_SIZE);
+    for (int i = 0; i < BENCH_FILES; i++) {
+        snprintf (paths[i], PATH_MAX, "%s/waveform_bench_%03d", dir, i);
+        int fd = open (paths[i], O_CREAT | O_WRONLY | O_TRUNC, 0644);
+        if (fd < 0 || write (fd, data, BENCH_FILE_SIZE) != BENCH_FILE_SIZE) {
+            fprintf (stderr, "locality_bench: can't write %s\n", paths[i]);
+            return 1;
+        }
+        close (fd);
+    }
+    free (data);
+
+    int order[BENCH_FILES];
+    for (int i = 0; i < BENCH_FILES; i++) {
+        order[i] = i;
+    }
+    srand (1);
+    for (int i = BENCH_FILES - 1; i > 0; i--) {
+        const int j = rand () % (i + 1);
+        const int t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    // fresh files may have no extents before they reach the disk
+    bench_evict ();
+    queue_init ();
+    for (int i = 0; i < BENCH_FILES; i++) {
+        strcpy (queued[i], paths[order[i]]);
+        queue_push (queued[i], NULL, JOB_PRIORITY_BATCH, waveform_locality (queued[i]));
+    }
+    for (int i = 0; i < BENCH_FILES; i++) {
+        char *key = queue_take (NULL, NULL);
+        strcpy (taken[i], key);
+        queue_pop (key);
+        free (key);
+    }
+    queue_free ();
+
+    printf ("%d files of %d KiB in %s\n", BENCH_FILES, BENCH_FILE_SIZE / 1024, dir);
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        double queued_distance = 0;
+        double taken_distance = 0;
+        const double queued_time = bench_read (queued, &queued_distance);
+        const double taken_time = bench_read (taken, &taken_distance);
+        printf ("queued order %.3f s, %.2f GiB apart | disk order %.3f s, %.2f GiB apart\n",
+                queued_time, queued_distance / (1 << 30), taken_time, taken_distance / (1 << 30));
+    }
+
+    for (int i = 0; i < BENCH_FILES; i++) {
+        unlink (paths[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,169 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+// Pushes, takes, pops and cancels jobs of the registry from many threads at
+// once and checks that no key is handed out twice while it runs and that
+// every item reference is given back.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <deadbeef/deadbeef.h>
+
+#include "../utils.h"
+#include "stub.h"
+
+#define STRESS_THREADS (16)
+#define STRESS_ROUNDS (20000)
+#define STRESS_KEYS (512)
+
+#define CHECK(X) do { if (!(X)) { fprintf (stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #X); exit (1); } } while (0)
+
+static DB_playItem_t items[STRESS_KEYS];
+static int refs[STRESS_KEYS];
+static int running[STRESS_KEYS];
+
+static void
+stress_item_ref (DB_playItem_t *it)
+{
+    __atomic_add_fetch (&refs[it - items], 1, __ATOMIC_RELAXED);
+}
+
+static void
+stress_item_unref (DB_playItem_t *it)
+{
+    CHECK (__atomic_sub_fetch (&refs[it - items], 1, __ATOMIC_RELAXED) >= 0);
+}
+
+static int
+stress_key_index (const char *key)
+{
+    return atoi (key + 1);
+}
+
+static void
+stress_run (char *key, DB_playItem_t *it)
+{
+    const int k = stress_key_index (key);
+    CHECK (it == &items[k]);
+    CHECK (__atomic_add_fetch (&running[k], 1, __ATOMIC_ACQ_REL) == 1);
+    CHECK (queue_contains (key));
+    CHECK (__atomic_sub_fetch (&running[k], 1, __ATOMIC_ACQ_REL) == 0);
+    stress_item_unref (it);
+    queue_pop (key);
+    free (key);
+}
+
+static int
+stress_filter (const char *key, DB_playItem_t *it, int priority, void *ctx)
+{
+    return stress_key_index (key) % 7 == *(int *)ctx;
+}
+
+static void *
+stress_thread (void *ctx)
+{
+    unsigned seed = (unsigned)(uintptr_t)ctx;
+    char key[16];
+    for (int i = 0; i < STRESS_ROUNDS; i++) {
+        const int k = rand_r (&seed) % STRESS_KEYS;
+        snprintf (key, sizeof (key), "k%d", k);
+        DB_playItem_t *it = NULL;
+        int priority = 0;
+        char *taken = NULL;
+        switch (rand_r (&seed) % 8) {
+        case 0:
+        case 1:
+        case 2:
+            queue_push (key, &items[k], rand_r (&seed) % 3, rand_r (&seed) % 2 ? (uint64_t)k + 1 : 0);
+            break;
+        case 3:
+        case 4:
+            taken = queue_take (&it, &priority);
+            break;
+        case 5:
+            taken = queue_take_urgent (1, &it, &priority);
+            break;
+        case 6:
+            queue_cancel (key);
+            break;
+        default: {
+            int remainder = k % 7;
+            queue_cancel_matching (stress_filter, &remainder);
+            queue_is_cancelled (key);
+            queue_pending ();
+            break;
+        }
+        }
+        if (taken) {
+            stress_run (taken, it);
+        }
+    }
+    return NULL;
+}
+
+int
+main (void)
+{
+    stub_init ();
+    deadbeef->pl_item_ref = stress_item_ref;
+    deadbeef->pl_item_unref = stress_item_unref;
+
+    // nothing is registered before the plugin started
+    CHECK (!queue_push ("k0", &items[0], 0, 0));
+    CHECK (!queue_take (NULL, NULL));
+    CHECK (queue_is_cancelled ("k0"));
+
+    queue_init ();
+    pthread_t threads[STRESS_THREADS];
+    for (int i = 0; i < STRESS_THREADS; i++) {
+        CHECK (pthread_create (&threads[i], NULL, stress_thread, (void *)(uintptr_t)(i + 1)) == 0);
+    }
+    for (int i = 0; i < STRESS_THREADS; i++) {
+        pthread_join (threads[i], NULL);
+    }
+
+    // whatever is left is handed out in priority order
+    DB_playItem_t *it = NULL;
+    int priority = 0;
+    int last = -1;
+    char *key;
+    while ((key = queue_take (&it, &priority))) {
+        CHECK (priority >= last);
+        last = priority;
+        stress_run (key, it);
+    }
+    CHECK (queue_pending () == 0);
+    for (int k = 0; k < STRESS_KEYS; k++) {
+        char name[16];
+        snprintf (name, sizeof (name), "k%d", k);
+        CHECK (!queue_contains (name));
+        CHECK (refs[k] == 0);
+    }
+    queue_free ();
+
+    // and nothing after it stopped
+    CHECK (!queue_push ("k0", &items[0], 0, 0));
+    CHECK (refs[0] == 0);
+    printf ("queue_stress: %d threads x %d rounds passed\n", STRESS_THREADS, STRESS_ROUNDS);
+    return 0;
+}
@@ -0,0 +1,74 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "stub.h"
+
+static DB_functions_t api;
+DB_functions_t *deadbeef = &api;
+
+static uintptr_t
+stub_mutex_create (void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init (&attr);
+    pthread_mutexattr_settype (&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_t *m = malloc (sizeof (pthread_mutex_t));
+    pthread_mutex_init (m, &attr);
+    pthread_mutexattr_destroy (&attr);
+    return (uintptr_t)m;
+}
+
+static void
+stub_mutex_free (uintptr_t m)
+{
+    pthread_mutex_destroy ((pthread_mutex_t *)m);
+    free ((void *)m);
+}
+
+static int
+stub_mutex_lock (uintptr_t m)
+{
+    return pthread_mutex_lock ((pthread_mutex_t *)m);
+}
+
+static int
+stub_mutex_unlock (uintptr_t m)
+{
+    return pthread_mutex_unlock ((pthread_mutex_t *)m);
+}
+
+static void
+stub_item_ref (DB_playItem_t *it)
+{
+}
+
+void
+stub_init (void)
+{
+    api.mutex_create = stub_mutex_create;
+    api.mutex_free = stub_mutex_free;
+    api.mutex_lock = stub_mutex_lock;
+    api.mutex_unlock = stub_mutex_unlock;
+    api.pl_item_ref = stub_item_ref;
+    api.pl_item_unref = stub_item_ref;
+}
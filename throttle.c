@@ -0,0 +1,233 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    Based on sndfile-tools waveform by Erik de Castro Lopo.
+        waveform.c - v1.04
+        Copyright (C) 2007-2012 Erik de Castro Lopo <erikd@mega-nerd.com>
+        Copyright (C) 2012 Robin Gareus <robin@gareus.org>
+        Copyright (C) 2013 driedfruit <driedfruit@mindloop.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+#endif
+
+#include <deadbeef/deadbeef.h>
+
+#include "throttle.h"
+#include "waveform.h"
+
+#ifndef MIN
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#endif
+#ifndef MAX
+#define MAX(a,b) (((a)>(b))?(a):(b))
+#endif
+
+// see linux/ioprio.h
+#define IOPRIO_CLASS_SHIFT (13)
+#define IOPRIO_CLASS_NONE (0)
+#define IOPRIO_CLASS_BE (2)
+#define IOPRIO_CLASS_IDLE (3)
+#define IOPRIO_WHO_PROCESS (1)
+
+// Locality keys carry their kind in the top bits, so disk offsets and
+// directory inodes are never sorted against each other: all files with a
+// known position come first, then the rest grouped by directory.
+#define LOCALITY_EXTENT ((uint64_t)1 << 62)
+#define LOCALITY_DIRECTORY ((uint64_t)2 << 62)
+#define LOCALITY_VALUE(X) ((X) & (((uint64_t)1 << 62) - 1))
+
+// bytes kept cached behind the read position, compressed files only have
+// an estimated position
+#define THROTTLE_KEEP_BEHIND (4 << 20)
+
+int
+waveform_throttle_io_priority (int idle)
+{
+#if defined(__linux__) && defined(SYS_ioprio_set) && defined(SYS_ioprio_get)
+    // pid 0 is the calling thread
+    const int previous = (int)syscall (SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0);
+    const int prio = idle ? IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT : (IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT) | 7;
+    if (syscall (SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, prio) != 0) {
+        trace ("waveform: ioprio_set failed.\n");
+        return -1;
+    }
+    return previous;
+#else
+    (void)idle;
+    return -1;
+#endif
+}
+
+void
+waveform_throttle_io_restore (int previous)
+{
+#if defined(__linux__) && defined(SYS_ioprio_set)
+    if (previous < 0) {
+        return;
+    }
+    // a thread without a class of its own follows its nice value, the
+    // level reported for it is not accepted back by older kernels
+    if (previous >> IOPRIO_CLASS_SHIFT == IOPRIO_CLASS_NONE) {
+        previous = IOPRIO_CLASS_NONE << IOPRIO_CLASS_SHIFT;
+    }
+    if (syscall (SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, previous) != 0) {
+        trace ("waveform: ioprio_set failed.\n");
+    }
+#else
+    (void)previous;
+#endif
+}
+
+int
+waveform_throttle_busy (float max_load, int min_buffer_ms)
+{
+    if (max_load > 0) {
+        double load = 0;
+        const long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+        if (getloadavg (&load, 1) == 1 && load / MAX (cpus, 1) > max_load) {
+            return 1;
+        }
+    }
+    if (min_buffer_ms > 0) {
+        DB_output_t *output = deadbeef->get_output ();
+        if (output && output->state () == OUTPUT_STATE_PLAYING) {
+            const int64_t bytes = (int64_t)output->fmt.samplerate * output->fmt.channels * (output->fmt.bps / 8) * min_buffer_ms / 1000;
+            if (bytes > 0 && !deadbeef->streamer_ok_to_read ((int)MIN (bytes, INT32_MAX))) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+int
+waveform_readahead_open (waveform_readahead_t *r, const char *path, const void *map)
+{
+    r->fd = open (path, O_RDONLY);
+    r->map = map;
+    r->advised = 0;
+    r->kept = 0;
+    struct stat st;
+    if (r->fd < 0 || fstat (r->fd, &st) != 0) {
+        waveform_readahead_close (r);
+        return -1;
+    }
+    r->size = st.st_size;
+    return 0;
+}
+
+void
+waveform_readahead_advise (waveform_readahead_t *r, int64_t offset, int64_t length, int drop_behind)
+{
+    if (r->fd < 0) {
+        return;
+    }
+    offset = MAX (0, MIN (offset, r->size));
+    const int64_t end = MIN (offset + length, r->size);
+    if (offset < r->kept || offset > r->advised) {
+        // moved elsewhere, start over from there
+        r->kept = offset;
+        r->advised = offset;
+    }
+    if (end > r->advised) {
+        posix_fadvise (r->fd, r->advised, end - r->advised, POSIX_FADV_WILLNEED);
+        r->advised = end;
+    }
+    if (drop_behind && offset - THROTTLE_KEEP_BEHIND > r->kept) {
+        const int64_t drop_end = offset - THROTTLE_KEEP_BEHIND;
+        if (r->map) {
+            // mapped pages stay cached until they are unmapped
+            const int64_t page = sysconf (_SC_PAGESIZE);
+            const int64_t start = r->kept / page * page;
+            madvise ((char *)r->map + start, drop_end - start, MADV_DONTNEED);
+        }
+        posix_fadvise (r->fd, r->kept, drop_end - r->kept, POSIX_FADV_DONTNEED);
+        r->kept = drop_end;
+    }
+}
+
+void
+waveform_readahead_close (waveform_readahead_t *r)
+{
+    if (r->fd >= 0) {
+        close (r->fd);
+    }
+    r->fd = -1;
+}
+
+#ifdef __linux__
+static uint64_t
+waveform_first_extent (const char *path)
+{
+    int fd = open (path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    uint64_t physical = 0;
+    struct fiemap *map = calloc (1, sizeof (struct fiemap) + sizeof (struct fiemap_extent));
+    if (map) {
+        map->fm_length = FIEMAP_MAX_OFFSET;
+        map->fm_extent_count = 1;
+        if (ioctl (fd, FS_IOC_FIEMAP, map) == 0 && map->fm_mapped_extents > 0
+            && !(map->fm_extents[0].fe_flags & FIEMAP_EXTENT_UNKNOWN)) {
+            physical = map->fm_extents[0].fe_physical;
+        }
+        free (map);
+    }
+    close (fd);
+    return physical;
+}
+#endif
+
+uint64_t
+waveform_locality (const char *path)
+{
+#ifdef __linux__
+    const uint64_t physical = waveform_first_extent (path);
+    if (physical > 0) {
+        return LOCALITY_EXTENT | LOCALITY_VALUE (physical);
+    }
+#endif
+    char *dir = strdup (path);
+    if (!dir) {
+        return 0;
+    }
+    char *slash = strrchr (dir, '/');
+    uint64_t locality = 0;
+    struct stat st;
+    if (slash) {
+        *slash = 0;
+        if (stat (slash == dir ? "/" : dir, &st) == 0) {
+            locality = LOCALITY_DIRECTORY | LOCALITY_VALUE ((uint64_t)st.st_ino);
+        }
+    }
+    free (dir);
+    return locality;
+}
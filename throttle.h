@@ -0,0 +1,79 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    Based on sndfile-tools waveform by Erik de Castro Lopo.
+        waveform.c - v1.04
+        Copyright (C) 2007-2012 Erik de Castro Lopo <erikd@mega-nerd.com>
+        Copyright (C) 2012 Robin Gareus <robin@gareus.org>
+        Copyright (C) 2013 driedfruit <driedfruit@mindloop.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef THROTTLE_HEADER
+#define THROTTLE_HEADER
+
+#include <stdint.h>
+
+// Keeps background analysis out of the way of playback: lower I/O priority,
+// pauses while the machine is busy and page cache hints for the files read.
+
+// Puts the calling thread in the idle I/O class, or back to the lowest best
+// effort level. Returns the previous priority for waveform_throttle_io_restore,
+// -1 if it was not changed. Linux only, a no-op elsewhere.
+int
+waveform_throttle_io_priority (int idle);
+
+void
+waveform_throttle_io_restore (int previous);
+
+// Whether analysis should pause: the load average per CPU is above max_load
+// or less than min_buffer_ms of audio is buffered for playback. A value of 0
+// disables either check.
+int
+waveform_throttle_busy (float max_load, int min_buffer_ms);
+
+typedef struct
+{
+    int fd;
+    int64_t size;
+    // mapping of the whole file, if it is read through one
+    const void *map;
+    // end of the range advised for reading, start of what is left cached
+    int64_t advised;
+    int64_t kept;
+} waveform_readahead_t;
+
+int
+waveform_readahead_open (waveform_readahead_t *r, const char *path, const void *map);
+
+// Asks for length bytes at offset to be read ahead. With drop_behind, pages
+// well before offset are dropped from the page cache.
+void
+waveform_readahead_advise (waveform_readahead_t *r, int64_t offset, int64_t length, int drop_behind);
+
+void
+waveform_readahead_close (waveform_readahead_t *r);
+
+// Sort key for reading files in on-disk order: the physical offset of the
+// first extent, or where extents are not reported the inode of the parent
+// directory, so that files of one directory stay together. Keys of the
+// second kind sort after all of the first. 0 if nothing is known.
+uint64_t
+waveform_locality (const char *path);
+
+#endif
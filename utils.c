@@ -37,65 +37,525 @@
 #include "waveform.h"
 #include "utils.h"
 
+#define QUEUE_BUCKETS_MIN (64)
+#define QUEUE_HEAP_MIN (64)
+
 typedef struct cache_query_s
 {
     char *fname;
+    uint32_t hash;
+    int priority;
+    // insertion order, keeps entries of equal priority FIFO
+    uint64_t seq;
+    // on-disk position and the pass over the disk it is read in, 0 for
+    // entries kept in insertion order
+    uint64_t locality;
+    uint64_t sweep;
+    // position in the pending heap, -1 once taken or never pending
+    int heap_index;
+    // set on running entries whose job should stop at the next chunk
+    int cancelled;
+    // set on running entries pushed again after they were cancelled, they
+    // go back to the heap when their job pops them
+    int requeue;
+    DB_playItem_t *it;
     struct cache_query_s *next;
 } cache_query_t;
 
 static uintptr_t mutex = 0;
-static cache_query_t *queue;
-static cache_query_t *queue_tail;
+static cache_query_t **buckets;
+static size_t num_buckets;
+static size_t num_entries;
+static cache_query_t **heap;
+static size_t heap_len;
+static size_t heap_size;
+static uint64_t seq_counter;
+// pass over the disk in progress and the position it reached
+static uint64_t sweep_current;
+static uint64_t sweep_position;
 
-int
-queue_add (const char *fname)
+static uint32_t
+queue_hash (const char *fname)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)fname; *c; c++) {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int
+queue_entry_before (cache_query_t *a, cache_query_t *b)
+{
+    if (a->priority != b->priority) {
+        return a->priority < b->priority;
+    }
+    if (a->sweep != b->sweep) {
+        return a->sweep < b->sweep;
+    }
+    if (a->locality != b->locality) {
+        return a->locality < b->locality;
+    }
+    return a->seq < b->seq;
+}
+
+static void
+queue_heap_swap (size_t i, size_t j)
+{
+    cache_query_t *tmp = heap[i];
+    heap[i] = heap[j];
+    heap[j] = tmp;
+    heap[i]->heap_index = i;
+    heap[j]->heap_index = j;
+}
+
+static void
+queue_heap_up (size_t i)
+{
+    while (i > 0) {
+        const size_t parent = (i - 1) / 2;
+        if (!queue_entry_before (heap[i], heap[parent])) {
+            break;
+        }
+        queue_heap_swap (i, parent);
+        i = parent;
+    }
+}
+
+static void
+queue_heap_down (size_t i)
+{
+    for (;;) {
+        const size_t left = 2 * i + 1;
+        const size_t right = left + 1;
+        size_t best = i;
+        if (left < heap_len && queue_entry_before (heap[left], heap[best])) {
+            best = left;
+        }
+        if (right < heap_len && queue_entry_before (heap[right], heap[best])) {
+            best = right;
+        }
+        if (best == i) {
+            break;
+        }
+        queue_heap_swap (i, best);
+        i = best;
+    }
+}
+
+static int
+queue_heap_insert (cache_query_t *q)
+{
+    if (heap_len == heap_size) {
+        const size_t size = heap_size ? heap_size * 2 : QUEUE_HEAP_MIN;
+        cache_query_t **tmp = realloc (heap, size * sizeof (cache_query_t *));
+        if (!tmp) {
+            return 0;
+        }
+        heap = tmp;
+        heap_size = size;
+    }
+    q->heap_index = heap_len;
+    heap[heap_len++] = q;
+    queue_heap_up (q->heap_index);
+    return 1;
+}
+
+static void
+queue_heap_remove (cache_query_t *q)
+{
+    if (q->heap_index < 0) {
+        return;
+    }
+    const size_t i = q->heap_index;
+    q->heap_index = -1;
+    heap_len--;
+    if (i == heap_len) {
+        return;
+    }
+    heap[i] = heap[heap_len];
+    heap[i]->heap_index = i;
+    queue_heap_up (i);
+    queue_heap_down (heap[i]->heap_index);
+}
+
+static void
+queue_rehash (size_t size)
+{
+    cache_query_t **tmp = calloc (size, sizeof (cache_query_t *));
+    if (!tmp) {
+        return;
+    }
+    for (size_t i = 0; i < num_buckets; i++) {
+        cache_query_t *q = buckets[i];
+        while (q) {
+            cache_query_t *next = q->next;
+            q->next = tmp[q->hash & (size - 1)];
+            tmp[q->hash & (size - 1)] = q;
+            q = next;
+        }
+    }
+    free (buckets);
+    buckets = tmp;
+    num_buckets = size;
+}
+
+static cache_query_t *
+queue_find (const char *fname, uint32_t hash)
+{
+    if (!buckets) {
+        return NULL;
+    }
+    for (cache_query_t *q = buckets[hash & (num_buckets - 1)]; q; q = q->next) {
+        if (q->hash == hash && !strcmp (fname, q->fname)) {
+            return q;
+        }
+    }
+    return NULL;
+}
+
+void
+queue_init (void)
 {
     if (!mutex) {
         mutex = deadbeef->mutex_create ();
     }
+}
+
+void
+queue_free (void)
+{
+    if (!mutex) {
+        return;
+    }
     deadbeef->mutex_lock (mutex);
-    for (cache_query_t *q = queue; q; q = q->next) {
-        if (!strcmp (fname, q->fname)) {
-            // already queued
-            trace ("waveform: already queued. (%s)\n",fname);
-            deadbeef->mutex_unlock (mutex);
-            return 0;
+    for (size_t i = 0; i < num_buckets; i++) {
+        cache_query_t *q = buckets[i];
+        while (q) {
+            cache_query_t *next = q->next;
+            if (q->it) {
+                deadbeef->pl_item_unref (q->it);
+            }
+            free (q->fname);
+            free (q);
+            q = next;
+        }
+    }
+    free (buckets);
+    buckets = NULL;
+    num_buckets = 0;
+    num_entries = 0;
+    free (heap);
+    heap = NULL;
+    heap_len = 0;
+    heap_size = 0;
+    deadbeef->mutex_unlock (mutex);
+    deadbeef->mutex_free (mutex);
+    mutex = 0;
+}
+
+int
+queue_push (const char *fname, DB_playItem_t *it, int priority, uint64_t locality)
+{
+    if (!mutex) {
+        return 0;
+    }
+    const uint32_t hash = queue_hash (fname);
+    deadbeef->mutex_lock (mutex);
+    cache_query_t *q = queue_find (fname, hash);
+    if (q && q->heap_index < 0 && q->cancelled) {
+        // the job may have noticed the flag already, so it also runs again
+        // once it is popped and resumes from its checkpoint or the cache
+        q->cancelled = 0;
+        q->requeue = 1;
+        q->priority = priority < q->priority ? priority : q->priority;
+        if (it && it != q->it) {
+            deadbeef->pl_item_ref (it);
+            if (q->it) {
+                deadbeef->pl_item_unref (q->it);
+            }
+            q->it = it;
         }
+        trace ("waveform: queued again. (%s)\n",fname);
+        deadbeef->mutex_unlock (mutex);
+        return 1;
+    }
+    if (q) {
+        // already queued, only move it forward if it became more urgent
+        if (q->heap_index >= 0 && priority < q->priority) {
+            q->priority = priority;
+            queue_heap_up (q->heap_index);
+        }
+        trace ("waveform: already queued. (%s)\n",fname);
+        deadbeef->mutex_unlock (mutex);
+        return 0;
+    }
+    if (num_entries + 1 > num_buckets * 3 / 4) {
+        queue_rehash (num_buckets ? num_buckets * 2 : QUEUE_BUCKETS_MIN);
+    }
+    if (!buckets) {
+        deadbeef->mutex_unlock (mutex);
+        return 0;
+    }
+    q = calloc (1, sizeof (cache_query_t));
+    if (!q) {
+        deadbeef->mutex_unlock (mutex);
+        return 0;
     }
-    cache_query_t *q = malloc (sizeof (cache_query_t));
-    memset (q, 0, sizeof (cache_query_t));
     q->fname = strdup (fname);
-    if (queue_tail) {
-        queue_tail->next = q;
-        queue_tail = q;
+    q->hash = hash;
+    q->priority = priority;
+    q->seq = seq_counter++;
+    // files behind the current position wait for the next pass, so the
+    // disk is read in one direction and nothing is passed over for good
+    if (locality) {
+        q->locality = locality;
+        q->sweep = locality >= sweep_position ? sweep_current + 1 : sweep_current + 2;
+    }
+    if (!q->fname || !queue_heap_insert (q)) {
+        free (q->fname);
+        free (q);
+        deadbeef->mutex_unlock (mutex);
+        return 0;
     }
-    else {
-        queue = queue_tail = q;
+    if (it) {
+        deadbeef->pl_item_ref (it);
+        q->it = it;
     }
+    q->next = buckets[hash & (num_buckets - 1)];
+    buckets[hash & (num_buckets - 1)] = q;
+    num_entries++;
     trace ("waveform: queued. (%s)\n",fname);
     deadbeef->mutex_unlock (mutex);
     return 1;
 }
 
-void
-queue_pop (const char *fname)
+static char *
+queue_take_locked (DB_playItem_t **it, int *priority)
 {
+    cache_query_t *q = heap[0];
+    queue_heap_remove (q);
+    if (q->locality) {
+        sweep_current = q->sweep - 1;
+        sweep_position = q->locality;
+    }
+    if (priority) {
+        *priority = q->priority;
+    }
+    if (it) {
+        if (q->it) {
+            deadbeef->pl_item_ref (q->it);
+        }
+        *it = q->it;
+    }
+    return strdup (q->fname);
+}
+
+char *
+queue_take (DB_playItem_t **it, int *priority)
+{
+    if (!mutex) {
+        return NULL;
+    }
+    char *fname = NULL;
+    deadbeef->mutex_lock (mutex);
+    if (heap_len > 0) {
+        fname = queue_take_locked (it, priority);
+    }
+    deadbeef->mutex_unlock (mutex);
+    return fname;
+}
+
+char *
+queue_take_urgent (int priority, DB_playItem_t **it, int *out_priority)
+{
+    if (!mutex) {
+        return NULL;
+    }
+    char *fname = NULL;
+    deadbeef->mutex_lock (mutex);
+    if (heap_len > 0 && heap[0]->priority < priority) {
+        fname = queue_take_locked (it, out_priority);
+    }
+    deadbeef->mutex_unlock (mutex);
+    return fname;
+}
+
+int
+queue_contains (const char *fname)
+{
+    if (!mutex) {
+        return 0;
+    }
+    const uint32_t hash = queue_hash (fname);
+    deadbeef->mutex_lock (mutex);
+    const int found = queue_find (fname, hash) != NULL;
+    deadbeef->mutex_unlock (mutex);
+    return found;
+}
+
+size_t
+queue_pending (void)
+{
+    if (!mutex) {
+        return 0;
+    }
     deadbeef->mutex_lock (mutex);
-    cache_query_t *next = NULL;
-    for (cache_query_t *q = queue; q; q = q->next) {
-        if (!strcmp (fname, q->fname)) {
-            next = q->next;
-            if (q->fname) {
-                trace ("waveform: removed from queue. (%s)\n",q->fname);
-                free (q->fname);
+    const size_t pending = heap_len;
+    deadbeef->mutex_unlock (mutex);
+    return pending;
+}
+
+static void
+queue_remove_locked (const char *fname, uint32_t hash)
+{
+    if (!buckets) {
+        return;
+    }
+    cache_query_t **prev = &buckets[hash & (num_buckets - 1)];
+    for (cache_query_t *q = *prev; q; prev = &q->next, q = q->next) {
+        if (q->hash == hash && !strcmp (fname, q->fname)) {
+            *prev = q->next;
+            queue_heap_remove (q);
+            trace ("waveform: removed from queue. (%s)\n",q->fname);
+            if (q->it) {
+                deadbeef->pl_item_unref (q->it);
             }
+            free (q->fname);
             free (q);
+            num_entries--;
             break;
         }
     }
-    queue = next;
-    if (!queue) {
-        queue_tail = NULL;
+}
+
+int
+queue_pop (const char *fname)
+{
+    if (!mutex) {
+        return 0;
+    }
+    const uint32_t hash = queue_hash (fname);
+    deadbeef->mutex_lock (mutex);
+    cache_query_t *q = queue_find (fname, hash);
+    int requeued = 0;
+    if (q && q->requeue) {
+        q->requeue = 0;
+        q->seq = seq_counter++;
+        if (q->locality) {
+            q->sweep = sweep_current + 1;
+        }
+        requeued = queue_heap_insert (q);
+    }
+    if (!requeued) {
+        queue_remove_locked (fname, hash);
     }
     deadbeef->mutex_unlock (mutex);
+    return requeued;
+}
+
+void
+queue_cancel (const char *fname)
+{
+    if (!mutex) {
+        return;
+    }
+    const uint32_t hash = queue_hash (fname);
+    deadbeef->mutex_lock (mutex);
+    cache_query_t *q = queue_find (fname, hash);
+    if (q) {
+        if (q->heap_index >= 0) {
+            // nobody picked it up yet, just drop it
+            queue_remove_locked (fname, hash);
+        }
+        else {
+            trace ("waveform: cancelled. (%s)\n",fname);
+            q->cancelled = 1;
+            q->requeue = 0;
+        }
+    }
+    deadbeef->mutex_unlock (mutex);
+}
+
+void
+queue_cancel_all (void)
+{
+    if (!mutex) {
+        return;
+    }
+    deadbeef->mutex_lock (mutex);
+    while (heap_len > 0) {
+        cache_query_t *q = heap[0];
+        queue_remove_locked (q->fname, q->hash);
+    }
+    for (size_t i = 0; i < num_buckets; i++) {
+        for (cache_query_t *q = buckets[i]; q; q = q->next) {
+            q->cancelled = 1;
+            q->requeue = 0;
+        }
+    }
+    deadbeef->mutex_unlock (mutex);
+}
+
+// The filter runs without the registry lock held, so it may take the
+// playlist lock or query the streamer.
+void
+queue_cancel_matching (queue_filter_func filter, void *ctx)
+{
+    if (!mutex) {
+        return;
+    }
+    deadbeef->mutex_lock (mutex);
+    const size_t count = num_entries;
+    char **keys = calloc (count + 1, sizeof (char *));
+    DB_playItem_t **items = calloc (count + 1, sizeof (DB_playItem_t *));
+    int *priorities = calloc (count + 1, sizeof (int));
+    size_t n = 0;
+    if (keys && items && priorities) {
+        for (size_t i = 0; i < num_buckets; i++) {
+            for (cache_query_t *q = buckets[i]; q; q = q->next) {
+                if (q->cancelled) {
+                    continue;
+                }
+                keys[n] = strdup (q->fname);
+                if (q->it) {
+                    deadbeef->pl_item_ref (q->it);
+                }
+                items[n] = q->it;
+                priorities[n] = q->priority;
+                n++;
+            }
+        }
+    }
+    deadbeef->mutex_unlock (mutex);
+
+    for (size_t i = 0; i < n; i++) {
+        if (keys[i] && filter (keys[i], items[i], priorities[i], ctx)) {
+            queue_cancel (keys[i]);
+        }
+        if (items[i]) {
+            deadbeef->pl_item_unref (items[i]);
+        }
+        free (keys[i]);
+    }
+    free (keys);
+    free (items);
+    free (priorities);
+}
+
+int
+queue_is_cancelled (const char *fname)
+{
+    if (!mutex) {
+        return 1;
+    }
+    const uint32_t hash = queue_hash (fname);
+    deadbeef->mutex_lock (mutex);
+    cache_query_t *q = queue_find (fname, hash);
+    // entries that disappeared were cancelled before they were taken
+    const int cancelled = !q || q->cancelled;
+    deadbeef->mutex_unlock (mutex);
+    return cancelled;
 }
@@ -34,11 +34,60 @@
 #include <assert.h>
 #include <math.h>
 #include <fcntl.h>
+#include <stdint.h>
 
-int
-queue_add (const char *fname);
+#include <deadbeef/deadbeef.h>
+
+// Registry of pending and running analysis jobs. Entries are deduplicated by
+// key and handed out by ascending priority (lower value first), FIFO within
+// the same priority. Entries pushed with a non-zero locality come after those
+// and are handed out by ascending locality, one pass at a time like an
+// elevator. An entry stays registered after queue_take until
+// queue_pop, so in-flight jobs are not queued twice. Entries keep a reference
+// to their playlist item; queue_take hands out a new reference. Cancelling a
+// pending entry drops it, a running one is flagged and its job is expected to
+// poll queue_is_cancelled between chunks. Pushing a cancelled running entry
+// again clears the flag and queue_pop puts it back in the heap, returning 1.
+// queue_init and queue_free run at plugin start and stop. Outside of that
+// the other calls do nothing and queue_is_cancelled reports every job as
+// cancelled.
+
+void
+queue_init (void);
 
 void
+queue_free (void);
+
+int
+queue_push (const char *fname, DB_playItem_t *it, int priority, uint64_t locality);
+
+char *
+queue_take (DB_playItem_t **it, int *priority);
+
+char *
+queue_take_urgent (int priority, DB_playItem_t **it, int *out_priority);
+
+int
+queue_contains (const char *fname);
+
+size_t
+queue_pending (void);
+
+int
 queue_pop (const char *fname);
 
+typedef int (*queue_filter_func) (const char *fname, DB_playItem_t *it, int priority, void *ctx);
+
+void
+queue_cancel (const char *fname);
+
+void
+queue_cancel_all (void);
+
+void
+queue_cancel_matching (queue_filter_func filter, void *ctx);
+
+int
+queue_is_cancelled (const char *fname);
+
 #endif
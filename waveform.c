@@ -28,19 +28,28 @@
 #include <sys/stat.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <limits.h>
 #include <string.h>
 #include <assert.h>
 #include <math.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include <gtk/gtk.h>
 #include <deadbeef/deadbeef.h>
 #include <deadbeef/gtkui_api.h>
 
 #include "support.h"
+#include "analysis.h"
+#include "tap.h"
+#include "index.h"
+#include "throttle.h"
+#include "remote.h"
 #include "cache.h"
+#include "meter.h"
 #include "config.h"
 #include "config_dialog.h"
 #include "utils.h"
+#include "worker.h"
 #include "waveform.h"
 #include "render.h"
 #include "ruler.h"
@@ -48,11 +57,20 @@
 #define W_COLOR(X) (X)->r, (X)->g, (X)->b, (X)->a
 
 //#define M_PI (3.1415926535897932384626433832795029)
-// min, max, rms
-#define VALUES_PER_SAMPLE (3)
-#define MAX_CHANNELS (6)
 #define MAX_SAMPLES (4096)
+#define MAX_BUFFER_LEN (MAX_SAMPLES * VALUES_PER_SAMPLE * MAX_CHANNELS * sizeof (short))
+// upper bound for the analysis of a CUE image shared by its subtracks
+#define MAX_IMAGE_SAMPLES (65536)
+// seconds of an image that get CONFIG_NUM_SAMPLES columns, about a track
+#define IMAGE_TRACK_SECONDS (240)
+// jobs and checkpoints of a whole image are keyed by its URI after this
+#define IMAGE_KEY_PREFIX "image:"
 #define DISTANCE_THRESHOLD (100)
+// ms between two looks at the items added to playlists, the number of
+// pending jobs they are kept below and the items checked at each look
+#define ADDED_INTERVAL (250)
+#define ADDED_MAX_PENDING (32)
+#define ADDED_MAX_CHECKS (32)
 
 
 /* Global variables */
@@ -62,6 +80,15 @@ static ddb_gtkui_t *gtkui_plugin = NULL;
 
 static char cache_path[PATH_MAX];
 
+// Widgets that show the results of jobs. Jobs hold widgets_mutex while they
+// use one, so it isn't destroyed under them. cache_mutex keeps the writes of
+// one result together.
+static GList *widgets;
+static uintptr_t widgets_mutex;
+static uintptr_t cache_mutex;
+// last seek requested from a widget in ms, -1 once playback got there
+static gint seek_target = -1;
+
 enum PLAYBACK_STATUS { STOPPED = 0, PLAYING = 1, PAUSED = 2 };
 static int playback_status = STOPPED;
 static int waveform_instancecount;
@@ -76,7 +103,29 @@ typedef struct
     GtkWidget *frame;
     guint drawtimer;
     guint resizetimer;
+    guint dwelltimer;
+    DB_playItem_t *dwell_track;
+    // items added to playlists, handed to the workers a few at a time;
+    // added_seen holds the keys of every item looked at so far
+    guint addedtimer;
+    gint added_rescan;
+    GQueue *added;
+    GHashTable *added_seen;
+    // track expected to play next and its waveform once known, guarded by
+    // mutex
+    DB_playItem_t *next_track;
+    wavedata_t *next_wave;
+    gint redraw_pending;
+    // display columns changed since the last redraw, guarded by mutex
+    int dirty_first;
+    int dirty_last;
+    // columns the stream display has seen, see waveform_tap_stream_read
+    int64_t stream_head;
     wavedata_t *wave;
+    // meter values of the display columns, features_len values of them or
+    // none, guarded by mutex
+    short *features;
+    int features_len;
 
     waveform_colors_t colors;
     waveform_colors_t colors_shaded;
@@ -111,11 +160,17 @@ waveform_draw_cb (void *user_data);
 static gboolean
 waveform_redraw_cb (void *user_data);
 
+static void
+waveform_queue_redraw (void *user_data);
+
+static void
+waveform_queue_redraw_columns (void *user_data, int first, int last);
+
 static gboolean
 ruler_redraw_cb (void *user_data);
 
 static void
-waveform_draw (void *user_data, int shaded);
+waveform_draw (void *user_data, int shaded, int x, int strip_width);
 
 static gboolean
 waveform_set_refresh_interval (void *user_data, int interval);
@@ -191,6 +246,44 @@ waveform_colors_update (waveform_t *w)
     };
 }
 
+static int
+waveform_is_stream (DB_playItem_t *it)
+{
+    return waveform_tap_is_stream (it, CONFIG_REMOTE_ENABLED);
+}
+
+static int
+waveform_meter_stages (void)
+{
+    return (CONFIG_METERS_ENABLED ? METER_LEVELS : 0)
+        | (CONFIG_BAND_COLORS ? METER_BANDS : 0)
+        | (CONFIG_MIX_TO_MONO || CONFIG_MID_SIDE ? METER_MIX : 0);
+}
+
+// Listens to playback only while it is of use for the playing track: the
+// window of a stream, or a local track that is about to be analyzed in tap
+// mode.
+static void
+waveform_update_tap (DB_playItem_t *it, int analyzing)
+{
+    int wanted = 0;
+    if (it && waveform_is_stream (it)) {
+        wanted = CONFIG_STREAM_ENABLED;
+    }
+    else if (it && analyzing && CONFIG_PLAYBACK_TAP && !waveform_meter_stages ()) {
+        deadbeef->pl_lock ();
+        const char *uri = deadbeef->pl_find_meta_raw (it, ":URI");
+        wanted = uri && deadbeef->is_local_file (uri);
+        deadbeef->pl_unlock ();
+    }
+    if (wanted) {
+        waveform_tap_start (CONFIG_NUM_SAMPLES, CONFIG_STREAM_WINDOW * 60, CONFIG_PLAYBACK_TAP, CONFIG_REMOTE_ENABLED);
+    }
+    else {
+        waveform_tap_stop ();
+    }
+}
+
 static int
 on_config_changed (void *widget)
 {
@@ -216,7 +309,14 @@ on_config_changed (void *widget)
     }
 
     waveform_set_refresh_interval (w, CONFIG_REFRESH_INTERVAL);
-    g_idle_add (waveform_redraw_cb, w);
+    worker_pool_set_size (CONFIG_NUM_WORKERS, CONFIG_BATCH_READERS);
+    // whether the playing track is still analyzed isn't known here
+    DB_playItem_t *it = deadbeef->streamer_get_playing_track ();
+    waveform_update_tap (it, 1);
+    if (it) {
+        deadbeef->pl_item_unref (it);
+    }
+    waveform_queue_redraw (w);
     g_idle_add (ruler_redraw_cb, w);
     return 0;
 }
@@ -316,6 +416,22 @@ ruler_redraw_cb (void *user_data)
     return FALSE;
 }
 
+static void
+waveform_stream_update (waveform_t *w, DB_playItem_t *it)
+{
+    int channels = 0;
+    deadbeef->mutex_lock (w->mutex);
+    const int n = waveform_tap_stream_read (it, &w->stream_head, w->wave->data, CONFIG_NUM_SAMPLES, &channels);
+    if (n > 0) {
+        w->wave->channels = channels;
+        w->wave->data_len = n * channels * VALUES_PER_SAMPLE;
+    }
+    deadbeef->mutex_unlock (w->mutex);
+    if (n > 0) {
+        waveform_queue_redraw (w);
+    }
+}
+
 static gboolean
 waveform_draw_cb (void *user_data)
 {
@@ -323,8 +439,14 @@ waveform_draw_cb (void *user_data)
 
     DB_playItem_t *trk = deadbeef->streamer_get_playing_track ();
     if (!trk) {
+        w->drawtimer = 0;
         return FALSE;
     }
+    if (CONFIG_STREAM_ENABLED && waveform_is_stream (trk)) {
+        waveform_stream_update (w, trk);
+        deadbeef->pl_item_unref (trk);
+        return TRUE;
+    }
     
     GtkAllocation a;
     gtk_widget_get_allocation (w->drawarea, &a);
@@ -347,20 +469,78 @@ waveform_draw_cb (void *user_data)
     return TRUE;
 }
 
+// Repaints the parts of both surfaces showing the columns changed since the
+// last redraw, or all of them if the size changed.
 static gboolean
 waveform_redraw_cb (void *user_data)
 {
     waveform_t *w = user_data;
+    g_atomic_int_set (&w->redraw_pending, 0);
     if (w->resizetimer) {
         g_source_remove (w->resizetimer);
         w->resizetimer = 0;
     }
-    waveform_draw (w, 0);
-    waveform_draw (w, 1);
-    gtk_widget_queue_draw (w->drawarea);
+
+    deadbeef->mutex_lock (w->mutex);
+    const int first = w->dirty_first;
+    const int last = w->dirty_last;
+    const int column_size = w->wave->channels * VALUES_PER_SAMPLE;
+    const int columns = column_size > 0 ? (int)(w->wave->data_len / column_size) : 0;
+    w->dirty_first = 0;
+    w->dirty_last = 0;
+    deadbeef->mutex_unlock (w->mutex);
+
+    GtkAllocation a;
+    gtk_widget_get_allocation (w->drawarea, &a);
+    const int resized = !w->surf || !w->surf_shaded
+        || cairo_image_surface_get_width (w->surf) != a.width
+        || cairo_image_surface_get_height (w->surf) != a.height;
+    if (resized || columns <= 0 || a.width <= 0 || (first <= 0 && last >= columns)) {
+        waveform_draw (w, 0, 0, a.width);
+        waveform_draw (w, 1, 0, a.width);
+        gtk_widget_queue_draw (w->drawarea);
+        return FALSE;
+    }
+    if (first >= last) {
+        return FALSE;
+    }
+
+    // one pixel more on either side for the lines joining the neighbours
+    const int x1 = MAX (0, (int)((int64_t)first * a.width / columns) - 1);
+    const int x2 = MIN (a.width, (int)(((int64_t)MIN (last, columns) * a.width + columns - 1) / columns) + 1);
+    if (x1 >= x2) {
+        return FALSE;
+    }
+    waveform_draw (w, 0, x1, x2 - x1);
+    waveform_draw (w, 1, x1, x2 - x1);
+    gtk_widget_queue_draw_area (w->drawarea, x1, 0, x2 - x1, a.height);
     return FALSE;
 }
 
+// Bursts of redraw requests from other threads collapse into one idle callback
+static void
+waveform_queue_redraw_columns (void *user_data, int first, int last)
+{
+    waveform_t *w = user_data;
+    deadbeef->mutex_lock (w->mutex);
+    if (w->dirty_first < w->dirty_last) {
+        first = MIN (first, w->dirty_first);
+        last = MAX (last, w->dirty_last);
+    }
+    w->dirty_first = first;
+    w->dirty_last = last;
+    deadbeef->mutex_unlock (w->mutex);
+    if (g_atomic_int_compare_and_exchange (&w->redraw_pending, 0, 1)) {
+        g_idle_add (waveform_redraw_cb, w);
+    }
+}
+
+static void
+waveform_queue_redraw (void *user_data)
+{
+    waveform_queue_redraw_columns (user_data, 0, INT_MAX);
+}
+
 static void
 waveform_draw_text (cairo_t *cr, waveform_colors_t *color, const char *text, double x, double y)
 {
@@ -455,8 +635,9 @@ waveform_seekbar_draw (gpointer user_data, cairo_t *cr, waveform_rect_t *rect)
     const float pos = (deadbeef->streamer_get_playpos () * width)/ dur + left;
     int cursor_width = CONFIG_CURSOR_WIDTH;
 
-    if (!deadbeef->is_local_file (deadbeef->pl_find_meta_raw (trk, ":URI"))) {
-        if (w->drawtimer) {
+    const int stream = waveform_is_stream (trk);
+    if (stream && (!CONFIG_STREAM_ENABLED || w->stream_head <= 0)) {
+        if (!CONFIG_STREAM_ENABLED && w->drawtimer) {
             g_source_remove (w->drawtimer);
             w->drawtimer = 0;
         }
@@ -464,31 +645,35 @@ waveform_seekbar_draw (gpointer user_data, cairo_t *cr, waveform_rect_t *rect)
         waveform_draw_text (cr, &w->colors, "Streaming...", width/2,height/2);
     }
     else {
+        // the rolling window of a stream ends at the play position
+        const double played_width = stream ? width : pos - cursor_width;
         if (height != w->height || width != w->width) {
             cairo_save (cr);
             cairo_translate (cr, 0, 0);
             cairo_scale (cr, width/w->width, height/w->height);
             cairo_set_source_surface (cr, w->surf_shaded, 0, 0);
-            cairo_rectangle (cr, left, top, (pos - cursor_width) / (width/w->width), height / (height/w->height));
+            cairo_rectangle (cr, left, top, played_width / (width/w->width), height / (height/w->height));
             cairo_fill (cr);
             cairo_restore (cr);
         }
         else {
             cairo_set_source_surface (cr, w->surf_shaded, 0, 0);
-            cairo_rectangle (cr, left, top, pos - cursor_width, height);
+            cairo_rectangle (cr, left, top, played_width, height);
             cairo_fill (cr);
         }
 
-        waveform_rect_t cursor_rect = {
-            .x = pos - cursor_width,
-            .y = top,
-            .width = cursor_width,
-            .height = height,
-        };
-        waveform_draw_cairo_rectangle (cr, &w->colors.pb, &cursor_rect);
+        if (!stream) {
+            waveform_rect_t cursor_rect = {
+                .x = pos - cursor_width,
+                .y = top,
+                .width = cursor_width,
+                .height = height,
+            };
+            waveform_draw_cairo_rectangle (cr, &w->colors.pb, &cursor_rect);
 
-        if (w->seekbar_moving && dur >= 0) {
-            waveform_draw_seeking_cursor (w, cr, dur, rect);
+            if (w->seekbar_moving && dur >= 0) {
+                waveform_draw_seeking_cursor (w, cr, dur, rect);
+            }
         }
     }
 
@@ -508,8 +693,81 @@ waveform_draw_surface_update (cairo_surface_t *surface, double width, double hei
     return surface;
 }
 
+// Display columns shown at x of a surface width pixels wide.
+static void
+waveform_meter_span (int x, int width, int columns, int *from, int *to)
+{
+    *from = (int)MIN ((int64_t)x * columns / width, columns - 1);
+    *to = (int)MAX ((int64_t)(x + 1) * columns / width, *from + 1);
+}
+
+// Clip markers and the short-term loudness curve, from the top (0 LUFS) to
+// the bottom (-60 LUFS) of the widget.
+static void
+waveform_draw_meters (waveform_t *w, waveform_colors_t *colors, cairo_t *cr, int x_first, int x_last, int width, int height)
+{
+    if (!CONFIG_SHOW_CLIPS && !CONFIG_SHOW_LOUDNESS) {
+        return;
+    }
+    deadbeef->mutex_lock (w->mutex);
+    const int columns = w->features_len / METER_VALUES;
+    if (columns <= 0 || width <= 0) {
+        deadbeef->mutex_unlock (w->mutex);
+        return;
+    }
+    cairo_save (cr);
+    cairo_set_line_width (cr, 1);
+    if (CONFIG_SHOW_CLIPS) {
+        cairo_set_source_rgba (cr, 1.0, 0.0, 0.0, 0.8);
+        for (int x = x_first; x < x_last; x++) {
+            int from = 0;
+            int to = 0;
+            waveform_meter_span (x, width, columns, &from, &to);
+            for (const short *f = w->features + from * METER_VALUES; f < w->features + to * METER_VALUES; f += METER_VALUES) {
+                // inter-sample overs count as well
+                if (f[METER_CLIPS] > 0 || f[METER_TRUE_PEAK] > 1000) {
+                    cairo_move_to (cr, x + 0.5, 0);
+                    cairo_line_to (cr, x + 0.5, height);
+                    break;
+                }
+            }
+        }
+        cairo_stroke (cr);
+    }
+    if (CONFIG_SHOW_LOUDNESS) {
+        color_t clr = waveform_color_contrast (&colors->bg);
+        cairo_set_source_rgba (cr, clr.r, clr.g, clr.b, 0.6);
+        int joined = 0;
+        for (int x = x_first; x < x_last; x++) {
+            int from = 0;
+            int to = 0;
+            waveform_meter_span (x, width, columns, &from, &to);
+            int loudness = METER_LOUDNESS_NONE;
+            for (int c = from; c < to; c++) {
+                loudness = MAX (loudness, w->features[c * METER_VALUES + METER_LOUDNESS]);
+            }
+            if (loudness == METER_LOUDNESS_NONE) {
+                joined = 0;
+                continue;
+            }
+            const double y = height * CLAMP (loudness / -6000.0, 0.0, 1.0);
+            if (joined) {
+                cairo_line_to (cr, x + 0.5, y);
+            }
+            else {
+                cairo_move_to (cr, x + 0.5, y);
+            }
+            joined = 1;
+        }
+        cairo_stroke (cr);
+    }
+    cairo_restore (cr);
+    deadbeef->mutex_unlock (w->mutex);
+}
+
+// Only x to x + strip_width - 1 of the surface are painted.
 static void
-waveform_draw (void *user_data, int shaded)
+waveform_draw (void *user_data, int shaded, int x, int strip_width)
 {
     waveform_t *w = user_data;
     GtkAllocation a;
@@ -534,8 +792,16 @@ waveform_draw (void *user_data, int shaded)
     cairo_surface_flush (surface);
     cairo_t *cr = cairo_create (surface);
     assert (cr != NULL);
+    cairo_rectangle (cr, x, 0, strip_width, height);
+    cairo_clip (cr);
 
-    waveform_data_render_t *w_render_ctx = waveform_render_data_build (w->wave, width, CONFIG_MIX_TO_MONO);
+    // the path starts a pixel early so the strip joins its left neighbour
+    const int render_first = MAX (0, x - 1);
+    const int render_last = MIN (width, x + strip_width + 1);
+    deadbeef->mutex_lock (w->mutex);
+    waveform_data_render_t *w_render_ctx = waveform_render_data_build_range (w->wave, width, render_first, render_last, CONFIG_MIX_TO_MONO,
+                                                                             w->features, w->features_len / METER_VALUES);
+    deadbeef->mutex_unlock (w->mutex);
 
     // Draw background
     waveform_rect_t bg_rect = {
@@ -551,7 +817,6 @@ waveform_draw (void *user_data, int shaded)
         const int channels = w_render_ctx->num_channels;
         const double channel_height = height/channels;
         const double waveform_height = 0.9 * channel_height;
-        const double x = 0.0;
         double y = (channel_height - waveform_height)/2;
 
         waveform_colors_t *colors = &w->colors;
@@ -562,9 +827,9 @@ waveform_draw (void *user_data, int shaded)
         for (int ch = 0; ch < channels; ch++, y += channel_height) {
             waveform_sample_t *samples = w_render_ctx->samples[ch];
             waveform_rect_t rect = {
-                .x = x,
+                .x = render_first,
                 .y = y,
-                .width = width,
+                .width = render_last - render_first,
                 .height = waveform_height,
             };
             switch (CONFIG_RENDER_METHOD) {
@@ -579,6 +844,7 @@ waveform_draw (void *user_data, int shaded)
                     break;
             }
         }
+        waveform_draw_meters (w, colors, cr, render_first, render_last, width, height);
         if (!CONFIG_SHADE_WAVEFORM && shaded == 1) {
             waveform_draw_cairo_rectangle (cr, &w->colors_shaded.pb, &bg_rect);
         }
@@ -609,190 +875,402 @@ waveform_scale (void *user_data, cairo_t *cr, waveform_rect_t *rect)
     }
 }
 
-static gboolean
-waveform_generate_wavedata (gpointer user_data, DB_playItem_t *it, const char *uri, wavedata_t *wavedata)
+static int
+waveform_is_playing (DB_playItem_t *it)
 {
-    waveform_t *w = user_data;
-    const double width = CONFIG_NUM_SAMPLES;
+    DB_playItem_t *playing = deadbeef->streamer_get_playing_track ();
+    if (!playing) {
+        return 0;
+    }
+    deadbeef->pl_item_unref (playing);
+    return playing == it;
+}
 
-    DB_fileinfo_t *fileinfo = NULL;
+// What an analysis is shown as. The analysis of a CUE image is shared by
+// its subtracks, whichever of them plays gets its columns.
+typedef struct
+{
+    DB_playItem_t *track;
+    const char *image;
+} waveform_job_t;
 
-    deadbeef->pl_lock ();
-    const char *dec_meta = deadbeef->pl_find_meta_raw (it, ":DECODER");
-    char decoder_id[100];
-    if (dec_meta) {
-        strncpy (decoder_id, dec_meta, sizeof (decoder_id));
-    }
-    DB_decoder_t *dec = NULL;
-    DB_decoder_t **decoders = deadbeef->plug_get_decoder_list ();
-    for (int i = 0; decoders[i]; i++) {
-        if (!strcmp (decoders[i]->plugin.id, decoder_id)) {
-            dec = decoders[i];
-            break;
+// Copies columns into the display, merging neighbours if there are more
+// than it holds. Only display columns covering first to first + count - 1
+// of data are updated and queued for redrawing.
+static void
+waveform_set_wave (waveform_t *w, const short *data, int columns, int channels, int first, int count)
+{
+    const int column_size = channels * VALUES_PER_SAMPLE;
+    const int target = MIN (columns, MAX_SAMPLES);
+    first = CLAMP (first, 0, columns);
+    count = CLAMP (count, 0, columns - first);
+    deadbeef->mutex_lock (w->mutex);
+    if (w->wave->channels != channels || w->wave->data_len != target * column_size) {
+        first = 0;
+        count = columns;
+    }
+    int target_first = first;
+    int target_last = first + count;
+    if (target == columns) {
+        memcpy (w->wave->data + first * column_size, data + first * column_size, count * column_size * sizeof (short));
+    }
+    else {
+        target_first = (int)((int64_t)first * target / columns);
+        target_last = (int)(((int64_t)(first + count) * target + columns - 1) / columns);
+        for (int c = target_first; c < target_last; c++) {
+            const int from = (int)((int64_t)c * columns / target);
+            const int to = (int)((int64_t)(c + 1) * columns / target);
+            short *out = w->wave->data + c * column_size;
+            for (int ch = 0; ch < channels; ch++, out += VALUES_PER_SAMPLE) {
+                const short *in = data + from * column_size + ch * VALUES_PER_SAMPLE;
+                short max = in[0];
+                short min = in[1];
+                float sum = 0.0;
+                for (int i = from; i < to; i++, in += column_size) {
+                    max = MAX (max, in[0]);
+                    min = MIN (min, in[1]);
+                    sum += (float)in[2] * in[2];
+                }
+                out[0] = max;
+                out[1] = min;
+                out[2] = (short)sqrtf (sum / (to - from));
+            }
         }
     }
-    deadbeef->pl_unlock ();
-
-    wavedata->data_len = 0;
-    wavedata->channels = 0;
+    w->wave->channels = channels;
+    w->wave->data_len = target * column_size;
+    deadbeef->mutex_unlock (w->mutex);
+    waveform_queue_redraw_columns (w, target_first, target_last);
+}
 
-    if (dec && dec->open) {
-        fileinfo = dec->open (0);
-        if (fileinfo && dec->init (fileinfo, DB_PLAYITEM (it)) != 0) {
-            deadbeef->pl_lock ();
-            fprintf (stderr, "waveform: failed to decode file %s\n", deadbeef->pl_find_meta (it, ":URI"));
-            deadbeef->pl_unlock ();
-            goto out;
+// Meter values for the display columns, merged like the waveform they go
+// with, which also takes care of the redraw. NULL data drops them.
+static void
+waveform_set_features (waveform_t *w, const short *data, int columns, int first, int count)
+{
+    const int target = MIN (columns, MAX_SAMPLES);
+    deadbeef->mutex_lock (w->mutex);
+    if (!data || columns <= 0) {
+        w->features_len = 0;
+        deadbeef->mutex_unlock (w->mutex);
+        return;
+    }
+    first = CLAMP (first, 0, columns);
+    count = CLAMP (count, 0, columns - first);
+    if (w->features_len != target * METER_VALUES) {
+        first = 0;
+        count = columns;
+    }
+    const int target_first = (int)((int64_t)first * target / columns);
+    const int target_last = (int)(((int64_t)(first + count) * target + columns - 1) / columns);
+    for (int c = target_first; c < target_last; c++) {
+        const int from = (int)((int64_t)c * columns / target);
+        const int to = (int)((int64_t)(c + 1) * columns / target);
+        const short *in = data + from * METER_VALUES;
+        short *out = w->features + c * METER_VALUES;
+        int peak = 0;
+        int clips = 0;
+        int loudness = METER_LOUDNESS_NONE;
+        float bands[3] = { 0.f, 0.f, 0.f };
+        for (int i = from; i < to; i++, in += METER_VALUES) {
+            peak = MAX (peak, in[METER_TRUE_PEAK]);
+            clips += in[METER_CLIPS];
+            loudness = MAX (loudness, in[METER_LOUDNESS]);
+            for (int b = 0; b < 3; b++) {
+                bands[b] += (float)in[METER_BAND_LOW + b] * in[METER_BAND_LOW + b];
+            }
+        }
+        out[METER_TRUE_PEAK] = (short)peak;
+        out[METER_CLIPS] = (short)MIN (clips, SHRT_MAX);
+        out[METER_LOUDNESS] = (short)loudness;
+        for (int b = 0; b < 3; b++) {
+            out[METER_BAND_LOW + b] = (short)sqrtf (bands[b] / (to - from));
         }
-        float *data;
-        float *buffer;
-
-        if (fileinfo) {
-            const float duration = deadbeef->pl_get_item_duration (it);
-            const int num_updates = MAX (1, floorf (duration)/30);
-            const int update_after_nsamples = width/num_updates;
-            if (duration <= 0) {
-                goto out;
+        // derived channels like waveform columns, leaving out those without
+        for (int k = METER_MONO; k <= METER_SIDE; k += VALUES_PER_SAMPLE) {
+            short max = METER_MIX_NONE;
+            short min = 0;
+            float sum = 0.f;
+            int n = 0;
+            for (in = data + from * METER_VALUES + k; in < data + to * METER_VALUES; in += METER_VALUES) {
+                if (in[0] == METER_MIX_NONE) {
+                    continue;
+                }
+                max = n ? MAX (max, in[0]) : in[0];
+                min = n ? MIN (min, in[1]) : in[1];
+                sum += (float)in[2] * in[2];
+                n++;
             }
-            const int bytes_per_sample = fileinfo->fmt.bps / 8;
-            const int samplesize = fileinfo->fmt.channels * bytes_per_sample;
-            const int nsamples_per_channel = floorf (duration * (float)fileinfo->fmt.samplerate);
-            const int samples_per_buf = ceilf ((float) nsamples_per_channel / (float) width);
-            const int max_samples_per_buf = 1 + samples_per_buf;
-
-            w->wave->channels = fileinfo->fmt.channels;
-            w->wave->data_len = w->wave->channels * 3 * CONFIG_NUM_SAMPLES;
-            deadbeef->mutex_lock (w->mutex);
-            memset (w->wave->data, 0, sizeof (short) * w->max_buffer_len);
-            deadbeef->mutex_unlock (w->mutex);
+            out[k] = max;
+            out[k + 1] = min;
+            out[k + 2] = n ? (short)sqrtf (sum / n) : 0;
+        }
+    }
+    w->features_len = target * METER_VALUES;
+    deadbeef->mutex_unlock (w->mutex);
+}
 
-            data = malloc (sizeof (float) * max_samples_per_buf * samplesize);
-            if (!data) {
-                trace ("waveform: out of memory.\n");
-                goto out;
-            }
-            memset (data, 0, sizeof (float) * max_samples_per_buf * samplesize);
+// Shows the cached meter values of it, or none.
+static void
+waveform_features_from_cache (waveform_t *w, DB_playItem_t *it, const char *uri)
+{
+    char *key = waveform_format_uri (it, uri);
+    short *data = key ? malloc (sizeof (short) * MAX_SAMPLES * METER_VALUES) : NULL;
+    int columns = 0;
+    const int len = data ? waveform_db_features_read (key, data, MAX_SAMPLES * METER_VALUES, &columns) : 0;
+    if (len > 0 && len == columns * METER_VALUES) {
+        waveform_set_features (w, data, columns, 0, columns);
+    }
+    else {
+        waveform_set_features (w, NULL, 0, 0, 0);
+    }
+    free (data);
+    free (key);
+}
 
-            buffer = malloc (sizeof (float) * max_samples_per_buf * samplesize);
-            if (!buffer) {
-                trace ("waveform: out of memory.\n");
-                goto out;
-            }
-            memset (buffer, 0, sizeof (float) * max_samples_per_buf * samplesize);
+// Sample range of a CUE subtrack within its image. If image_end is given,
+// the subtracks following in the playlist are checked to really be slices
+// of one file, and the image is taken to end with the last of them.
+static int
+waveform_subtrack_range (DB_playItem_t *it, const char *uri, int64_t *start, int64_t *end, int64_t *image_end)
+{
+    if (!(deadbeef->pl_get_item_flags (it) & DDB_IS_SUBTRACK) || it->endsample <= it->startsample) {
+        return 0;
+    }
+    *start = it->startsample;
+    *end = (int64_t)it->endsample + 1;
+    if (!image_end) {
+        return 1;
+    }
 
+    *image_end = *end;
+    DB_playItem_t *next = deadbeef->pl_get_next (it, PL_MAIN);
+    while (next) {
+        deadbeef->pl_lock ();
+        const char *next_uri = deadbeef->pl_find_meta_raw (next, ":URI");
+        const int same_image = next_uri && !strcmp (next_uri, uri);
+        deadbeef->pl_unlock ();
+        if (!same_image || !(deadbeef->pl_get_item_flags (next) & DDB_IS_SUBTRACK)) {
+            deadbeef->pl_item_unref (next);
+            break;
+        }
+        if (next->startsample < *image_end) {
+            // overlapping subtracks, e.g. subtunes of a chiptune
+            deadbeef->pl_item_unref (next);
+            return 0;
+        }
+        *image_end = (int64_t)next->endsample + 1;
+        DB_playItem_t *following = deadbeef->pl_get_next (next, PL_MAIN);
+        deadbeef->pl_item_unref (next);
+        next = following;
+    }
+    // nothing to share with
+    return *start > 0 || *image_end > *end;
+}
 
-            ddb_waveformat_t out_fmt = {
-                .bps = 32,
-                .channels = fileinfo->fmt.channels,
-                .samplerate = fileinfo->fmt.samplerate,
-                .channelmask = fileinfo->fmt.channelmask,
-                .is_float = 1,
-                .is_bigendian = 0
-            };
+// Whether the playing track is a subtrack of the image at uri, and its range.
+static int
+waveform_image_playing (const char *uri, int64_t *start, int64_t *end)
+{
+    DB_playItem_t *playing = deadbeef->streamer_get_playing_track ();
+    if (!playing) {
+        return 0;
+    }
+    deadbeef->pl_lock ();
+    const char *playing_uri = deadbeef->pl_find_meta_raw (playing, ":URI");
+    const int same_image = playing_uri && !strcmp (playing_uri, uri);
+    deadbeef->pl_unlock ();
+    const int result = same_image && waveform_subtrack_range (playing, uri, start, end, NULL);
+    deadbeef->pl_item_unref (playing);
+    return result;
+}
 
-            int update_counter = 0;
-            int eof = 0;
-            int counter = 0;
-            const long buffer_len = samples_per_buf * samplesize;
-            while (!eof) {
-                int sz = dec->read (fileinfo, (char *)buffer, buffer_len);
-                if (sz != buffer_len) {
-                    eof = 1;
-                }
-                else if (sz == 0) {
-                    break;
-                }
+static int
+waveform_is_image_key (const char *key)
+{
+    return !strncmp (key, IMAGE_KEY_PREFIX, strlen (IMAGE_KEY_PREFIX));
+}
 
-                deadbeef->pcm_convert (&fileinfo->fmt, (char *)buffer, &out_fmt, (char *)data, sz);
-
-                int sample;
-                float min, max, rms;
-
-                for (int ch = 0; ch < fileinfo->fmt.channels; ch++) {
-                    min = 1.0; max = -1.0; rms = 0.0;
-                    for (sample = 0; sample < sz/samplesize; sample++) {
-                        if (sample * fileinfo->fmt.channels > buffer_len) {
-                            fprintf (stderr, "index error!\n");
-                            break;
-                        }
-                        const float sample_val = data [sample * fileinfo->fmt.channels + ch];
-                        max = MAX (max, sample_val);
-                        min = MIN (min, sample_val);
-                        rms += (sample_val * sample_val);
-                    }
-                    rms /= sample;
-                    rms = sqrt (rms);
-                    wavedata->data[counter] = (short)(max*1000);
-                    wavedata->data[counter+1] = (short)(min*1000);
-                    wavedata->data[counter+2] = (short)(rms*1000);
-                    counter += 3;
-                }
-                if (update_counter == update_after_nsamples) {
-                    DB_playItem_t *playing = deadbeef->streamer_get_playing_track ();
-                    if (playing) {
-                        if (playing == it) {
-                            deadbeef->mutex_lock (w->mutex);
-                            w->wave->channels = fileinfo->fmt.channels;
-                            w->wave->data_len = w->wave->channels * VALUES_PER_SAMPLE * CONFIG_NUM_SAMPLES;
-                            memset (w->wave->data, 0, sizeof (short) * w->max_buffer_len);
-                            memcpy (w->wave->data, wavedata->data, counter * sizeof (short));
-                            deadbeef->mutex_unlock (w->mutex);
-                            g_idle_add (waveform_redraw_cb, w);
-                        }
-                        deadbeef->pl_item_unref (playing);
-                    }
-                    update_counter = 0;
-                }
-                update_counter++;
-            }
-            wavedata->fname = strdup (deadbeef->pl_find_meta_raw (it, ":URI"));
-            wavedata->data_len = counter;
-            wavedata->channels = fileinfo->fmt.channels;
+// Job key of the image a subtrack can share its analysis with, NULL if it
+// is analyzed on its own.
+static char *
+waveform_image_key (DB_playItem_t *it, const char *uri)
+{
+    int64_t start = 0;
+    int64_t end = 0;
+    int64_t image_end = 0;
+    deadbeef->pl_lock ();
+    const int has_decoder = deadbeef->pl_find_meta_raw (it, ":DECODER") != NULL;
+    deadbeef->pl_unlock ();
+    if (!has_decoder
+        || deadbeef->pl_find_meta_int (it, ":SAMPLERATE", 0) <= 0
+        || !waveform_subtrack_range (it, uri, &start, &end, &image_end)) {
+        return NULL;
+    }
+    const size_t key_len = strlen (IMAGE_KEY_PREFIX) + strlen (uri) + 1;
+    char *key = malloc (key_len);
+    if (key) {
+        snprintf (key, key_len, "%s%s", IMAGE_KEY_PREFIX, uri);
+    }
+    return key;
+}
+
+// Playlist-less item standing for the whole image of a subtrack.
+static DB_playItem_t *
+waveform_image_item (DB_playItem_t *it, const char *uri, int64_t frames)
+{
+    deadbeef->pl_lock ();
+    const char *decoder_meta = deadbeef->pl_find_meta_raw (it, ":DECODER");
+    char *decoder = decoder_meta ? strdup (decoder_meta) : NULL;
+    deadbeef->pl_unlock ();
+    const int samplerate = deadbeef->pl_find_meta_int (it, ":SAMPLERATE", 0);
+    if (!decoder || samplerate <= 0) {
+        free (decoder);
+        return NULL;
+    }
+    DB_playItem_t *image = deadbeef->pl_item_alloc ();
+    if (image) {
+        deadbeef->pl_add_meta (image, ":URI", uri);
+        deadbeef->pl_add_meta (image, ":DECODER", decoder);
+        deadbeef->pl_set_item_duration (image, (float)((double)frames / samplerate));
+    }
+    free (decoder);
+    return image;
+}
 
+static int
+waveform_image_cached (DB_playItem_t *it, const char *uri, int *first, int *count, int *channels)
+{
+    int64_t start = 0;
+    int64_t end = 0;
+    int64_t frames = 0;
+    int columns = 0;
+    if (!waveform_subtrack_range (it, uri, &start, &end, NULL)
+        || !waveform_db_image_info (uri, channels, &columns, &frames)
+        || start >= frames
+        || columns <= 0
+        || *channels <= 0
+        || *channels > MAX_CHANNELS) {
+        return 0;
+    }
+    waveform_analysis_slice (frames, columns, start, end, first, count);
+    return 1;
+}
 
-            if (data) {
-                free (data);
-                data = NULL;
-            }
-            if (buffer) {
-                free (buffer);
-                buffer = NULL;
-            }
+// Shows the columns of a subtrack from the cached analysis of its image,
+// only that part of the image is read.
+static int
+waveform_image_get_from_cache (waveform_t *w, DB_playItem_t *it, const char *uri)
+{
+    int first = 0;
+    int count = 0;
+    int channels = 0;
+    if (!waveform_image_cached (it, uri, &first, &count, &channels)) {
+        return 0;
+    }
+    const int column_size = channels * VALUES_PER_SAMPLE;
+    short *data = malloc (count * column_size * sizeof (short));
+    if (!data) {
+        return 0;
+    }
+    const int len = waveform_db_image_read (uri, first * column_size, data, count * column_size);
+    if (len >= column_size) {
+        waveform_set_wave (w, data, len / column_size, channels, 0, len / column_size);
+    }
+    free (data);
+    return len >= column_size;
+}
+
+static void
+waveform_analysis_progress (waveform_analysis_t *a, int first, int count, void *user_data)
+{
+    waveform_job_t *job = user_data;
+    if (job->image) {
+        int64_t start = 0;
+        int64_t end = 0;
+        if (!waveform_image_playing (job->image, &start, &end)) {
+            return;
         }
+        int slice_first = 0;
+        int slice_count = 0;
+        waveform_analysis_slice (a->total_frames, a->num_columns, start, end, &slice_first, &slice_count);
+        const int from = MAX (first, slice_first);
+        const int to = MIN (first + count, slice_first + slice_count);
+        if (to <= from) {
+            return;
+        }
+        deadbeef->mutex_lock (widgets_mutex);
+        for (GList *l = widgets; l; l = l->next) {
+            waveform_set_wave (l->data, a->wavedata->data + slice_first * a->channels * VALUES_PER_SAMPLE, slice_count, a->channels, from - slice_first, to - from);
+        }
+        deadbeef->mutex_unlock (widgets_mutex);
     }
-out:
-    if (dec && fileinfo) {
-        dec->free (fileinfo);
-        fileinfo = NULL;
+    else if (waveform_is_playing (job->track)) {
+        deadbeef->mutex_lock (widgets_mutex);
+        for (GList *l = widgets; l; l = l->next) {
+            if (a->features) {
+                waveform_set_features (l->data, a->features, a->num_columns, first, count);
+            }
+            waveform_set_wave (l->data, a->wavedata->data, a->num_columns, a->channels, first, count);
+        }
+        deadbeef->mutex_unlock (widgets_mutex);
     }
+}
 
-    return TRUE;
+static float
+waveform_analysis_focus (waveform_analysis_t *a, void *user_data)
+{
+    waveform_job_t *job = user_data;
+    int64_t start = 0;
+    int64_t end = 0;
+    if (job->image ? !waveform_image_playing (job->image, &start, &end) : !waveform_is_playing (job->track)) {
+        return -1;
+    }
+    const float offset = (float)((double)start / a->samplerate);
+    const float playpos = deadbeef->streamer_get_playpos ();
+    const int target = g_atomic_int_get (&seek_target);
+    if (target >= 0) {
+        // the streamer may not have picked up the seek yet
+        if (fabsf (playpos - target / 1000.f) > 1.f) {
+            return target / 1000.f + offset;
+        }
+        g_atomic_int_compare_and_exchange (&seek_target, target, -1);
+    }
+    return playpos + offset;
 }
 
 static void
-waveform_db_cache (gpointer user_data, DB_playItem_t *it, wavedata_t *wavedata)
+waveform_db_cache (DB_playItem_t *it, wavedata_t *wavedata, int approximate, short *features, int columns)
 {
-    waveform_t *w = user_data;
     char *key = waveform_format_uri (it, wavedata->fname);
     if (!key) {
         return;
     }
-    deadbeef->mutex_lock (w->mutex);
+    deadbeef->mutex_lock (cache_mutex);
     waveform_db_write (key, wavedata->data, wavedata->data_len * sizeof (short), wavedata->channels, 0);
-    deadbeef->mutex_unlock (w->mutex);
+    waveform_db_approximate_set (key, approximate);
+    if (features) {
+        waveform_db_features_write (key, features, columns * METER_VALUES * sizeof (short), columns);
+    }
+    else {
+        waveform_db_features_delete (key);
+    }
+    deadbeef->mutex_unlock (cache_mutex);
     if (key) {
         free (key);
         key = NULL;
     }
 }
 
+// Network files are copied before the analysis, that rules out streams and
+// CUE subtracks.
 static int
 waveform_valid_track (DB_playItem_t *it, const char *uri)
 {
-    if (!deadbeef->is_local_file (uri)) {
-        return 0;
-    }
-    if (deadbeef->pl_get_item_duration (it)/60 >= CONFIG_MAX_FILE_LENGTH && CONFIG_MAX_FILE_LENGTH != -1) {
+    if (!deadbeef->is_local_file (uri)
+        && (!CONFIG_REMOTE_ENABLED
+            || deadbeef->pl_get_item_duration (it) <= 0
+            || (deadbeef->pl_get_item_flags (it) & DDB_IS_SUBTRACK))) {
         return 0;
     }
 
@@ -814,6 +1292,13 @@ waveform_delete (DB_playItem_t *it, const char *uri)
         return 0;
     }
     int result = waveform_db_delete (key);
+    waveform_db_approximate_set (key, 0);
+    waveform_db_features_delete (key);
+    int64_t start = 0;
+    int64_t end = 0;
+    if (waveform_subtrack_range (it, uri, &start, &end, NULL)) {
+        waveform_db_image_delete (uri);
+    }
     if (key) {
         free (key);
         key = NULL;
@@ -829,6 +1314,12 @@ waveform_is_cached (DB_playItem_t *it, const char *uri)
         return 0;
     }
     int result = waveform_db_cached (key);
+    if (!result) {
+        int first = 0;
+        int count = 0;
+        int channels = 0;
+        result = waveform_image_cached (it, uri, &first, &count, &channels);
+    }
     if (key) {
         free (key);
         key = NULL;
@@ -836,6 +1327,20 @@ waveform_is_cached (DB_playItem_t *it, const char *uri)
     return result;
 }
 
+// cached entries that are only an MP3 estimate are analyzed again once the
+// track gets a non-batch job
+static int
+waveform_is_approximate (DB_playItem_t *it, const char *uri)
+{
+    char *key = waveform_format_uri (it, uri);
+    if (!key) {
+        return 0;
+    }
+    int result = waveform_db_approximate (key);
+    free (key);
+    return result;
+}
+
 static void
 waveform_get_from_cache (gpointer user_data, DB_playItem_t *it, const char *uri)
 {
@@ -846,80 +1351,668 @@ waveform_get_from_cache (gpointer user_data, DB_playItem_t *it, const char *uri)
     }
     deadbeef->mutex_lock (w->mutex);
     w->wave->data_len = waveform_db_read (key, w->wave->data, w->max_buffer_len, &w->wave->channels);
+    const int found = w->wave->data_len > 0;
     deadbeef->mutex_unlock (w->mutex);
+    if (!found) {
+        waveform_image_get_from_cache (w, it, uri);
+    }
+    waveform_features_from_cache (w, it, uri);
     if (key) {
         free (key);
         key = NULL;
     }
 }
 
-static void
-waveform_get_wavedata (gpointer user_data)
+static int
+waveform_remote_cancelled (void *ctx)
 {
-    waveform_t *w = user_data;
-    DB_playItem_t *it = deadbeef->streamer_get_playing_track ();
-    if (!it) {
-        return;
-    }
+    return queue_is_cancelled (ctx);
+}
 
-    char *uri = strdup (deadbeef->pl_find_meta_raw (it, ":URI"));
-    if (!uri) {
-        return;
-    }
-    if (!waveform_valid_track (it, uri)) {
-        return;
+// Stand-in for it that reads the local copy at path of its network file,
+// which is downloaded or completed first. unverified is set if the copy
+// can't be told apart from a truncated one.
+static DB_playItem_t *
+waveform_remote_item (DB_playItem_t *it, const char *key, const char *uri, const char *path, int *unverified)
+{
+    const int fetched = waveform_remote_fetch (uri, path, (int64_t)CONFIG_REMOTE_RATE * 1024, (int64_t)CONFIG_REMOTE_MAX_SIZE << 20, waveform_remote_cancelled, (void *)key);
+    if (fetched == REMOTE_TOO_LARGE) {
+        // decoded from the network instead, its seeks go there as well
+        trace ("waveform: no room to copy %s, streaming it\n", uri);
+        deadbeef->pl_item_ref (it);
+        return it;
+    }
+    if (fetched < 0) {
+        return NULL;
     }
-
-    deadbeef->background_job_increment ();
-    if (CONFIG_CACHE_ENABLED && waveform_is_cached (it, uri)) {
-        waveform_get_from_cache (w, it, uri);
-        g_idle_add (waveform_redraw_cb, w);
+    *unverified = fetched > 0;
+    deadbeef->pl_lock ();
+    const char *decoder_meta = deadbeef->pl_find_meta_raw (it, ":DECODER");
+    const char *filetype_meta = deadbeef->pl_find_meta_raw (it, ":FILETYPE");
+    char *decoder = decoder_meta ? strdup (decoder_meta) : NULL;
+    char *filetype = filetype_meta ? strdup (filetype_meta) : NULL;
+    deadbeef->pl_unlock ();
+    DB_playItem_t *local = decoder ? deadbeef->pl_item_alloc () : NULL;
+    if (local) {
+        deadbeef->pl_add_meta (local, ":URI", path);
+        deadbeef->pl_add_meta (local, ":DECODER", decoder);
+        if (filetype) {
+            deadbeef->pl_add_meta (local, ":FILETYPE", filetype);
+        }
+        deadbeef->pl_set_item_duration (local, deadbeef->pl_get_item_duration (it));
     }
-    else if (queue_add (uri)) {
-        wavedata_t *wavedata = malloc (sizeof (wavedata_t));
-        wavedata->data = malloc (sizeof (short) * w->max_buffer_len);
-        memset (wavedata->data, 0, sizeof (short) * w->max_buffer_len);
-        wavedata->fname = NULL;
+    free (decoder);
+    free (filetype);
+    return local;
+}
+
+// Copy of the decoders previewed for a job of the given priority, or NULL.
+// load_config rewrites the setting in place while jobs run.
+static char *
+waveform_preview_decoders (int priority)
+{
+    if (!CONFIG_PREVIEW_ENABLED || priority != JOB_PRIORITY_PLAYING) {
+        return NULL;
+    }
+    deadbeef->conf_lock ();
+    char *decoders = strdup (CONFIG_PREVIEW_DECODERS);
+    deadbeef->conf_unlock ();
+    return decoders;
+}
+
+static void
+waveform_analyze_track (const char *key, DB_playItem_t *it, int priority, const char *uri)
+{
+    // network files are analyzed from a local copy, decoder seeks stay local
+    const int remote = !deadbeef->is_local_file (uri);
+    char *remote_path = remote ? waveform_remote_path (cache_path, uri) : NULL;
+    int unverified = 0;
+    DB_playItem_t *source = remote_path ? waveform_remote_item (it, key, uri, remote_path, &unverified) : it;
+    if (!source) {
+        free (remote_path);
+        return;
+    }
+
+    wavedata_t *wavedata = malloc (sizeof (wavedata_t));
+    wavedata->data = malloc (sizeof (short) * MAX_BUFFER_LEN);
+    memset (wavedata->data, 0, sizeof (short) * MAX_BUFFER_LEN);
+    wavedata->fname = strdup (uri);
+    // the playback tap only has the waveform, metered tracks are decoded
+    const int meter_stages = waveform_meter_stages ();
+    short *features = meter_stages ? malloc (sizeof (short) * CONFIG_NUM_SAMPLES * METER_VALUES) : NULL;
+    // differs from key for a subtrack whose image could not be analyzed
+    char *checkpoint_key = waveform_format_uri (it, uri);
+    char *preview_decoders = waveform_preview_decoders (priority);
 
-        waveform_generate_wavedata (w, it, uri, wavedata);
-        if (CONFIG_CACHE_ENABLED) {
-            waveform_db_cache (w, it, wavedata);
+    waveform_job_t job = {
+        .track = it,
+    };
+    waveform_analysis_t analysis = {
+        .it = source,
+        .key = key,
+        .priority = priority,
+        .num_columns = CONFIG_NUM_SAMPLES,
+        .checkpoints = CONFIG_CACHE_ENABLED,
+        .checkpoint_key = checkpoint_key,
+        .preview_decoders = preview_decoders,
+        .progress = waveform_analysis_progress,
+        .focus = priority == JOB_PRIORITY_PLAYING ? waveform_analysis_focus : NULL,
+        .playback_tap = CONFIG_PLAYBACK_TAP && priority == JOB_PRIORITY_PLAYING && !remote && !features,
+        .mp3_envelope = CONFIG_MP3_ENVELOPE,
+        .approximate_only = CONFIG_MP3_ENVELOPE && priority == JOB_PRIORITY_BATCH && !remote,
+        .idle_io = CONFIG_IDLE_IO,
+        .max_load = CONFIG_MAX_LOAD / 100.f,
+        .min_buffer_ms = CONFIG_MIN_BUFFER,
+        .user_data = &job,
+        .wavedata = wavedata,
+        .data_size = MAX_BUFFER_LEN,
+        .features = features,
+        .meter_stages = meter_stages,
+    };
+    const int done = waveform_analysis_run (&analysis);
+    if (remote) {
+        // a cancelled job resumes from its checkpoint with the same copy
+        if (done || !queue_is_cancelled (key)) {
+            unlink (remote_path);
         }
-        queue_pop (uri);
+        free (remote_path);
+        deadbeef->pl_item_unref (source);
+    }
+    if (done && CONFIG_CACHE_ENABLED) {
+        // kept like an estimate, so the next time it plays it is fetched again
+        waveform_db_cache (it, wavedata, analysis.approximate || unverified, analysis.approximate ? NULL : features, analysis.num_columns);
+    }
 
-        DB_playItem_t *playing = deadbeef->streamer_get_playing_track ();
-        if (playing && it && it == playing) {
+    const int playing = done && waveform_is_playing (it);
+    deadbeef->mutex_lock (widgets_mutex);
+    for (GList *l = widgets; l && done; l = l->next) {
+        waveform_t *w = l->data;
+        if (playing) {
+            waveform_set_features (w, analysis.approximate ? NULL : features, analysis.num_columns, 0, analysis.num_columns);
             deadbeef->mutex_lock (w->mutex);
             memcpy (w->wave->data, wavedata->data, wavedata->data_len * sizeof (short));
             w->wave->data_len = wavedata->data_len;
             w->wave->channels = wavedata->channels;
             deadbeef->mutex_unlock (w->mutex);
-            g_idle_add (waveform_redraw_cb, w);
+            waveform_queue_redraw (w);
+        }
+        else if (!analysis.approximate) {
+            deadbeef->mutex_lock (w->mutex);
+            if (w->next_track == it) {
+                memcpy (w->next_wave->data, wavedata->data, wavedata->data_len * sizeof (short));
+                w->next_wave->data_len = wavedata->data_len;
+                w->next_wave->channels = wavedata->channels;
+            }
+            deadbeef->mutex_unlock (w->mutex);
+        }
+    }
+    deadbeef->mutex_unlock (widgets_mutex);
 
+    if (wavedata->data) {
+        free (wavedata->data);
+        wavedata->data = NULL;
+    }
+    if (wavedata->fname) {
+        free (wavedata->fname);
+        wavedata->fname = NULL;
+    }
+    if (wavedata) {
+        free (wavedata);
+        wavedata = NULL;
+    }
+    free (features);
+    free (checkpoint_key);
+    free (preview_decoders);
+}
+
+// Analyzes the whole image of a CUE subtrack, so every other subtrack of it
+// becomes a cache hit. Jobs of images run under the image key, the same for
+// all subtracks. Returns 0 if the image can't be analyzed on its own.
+static int
+waveform_analyze_image (const char *key, DB_playItem_t *it, int priority, const char *uri)
+{
+    int64_t start = 0;
+    int64_t end = 0;
+    int64_t image_end = 0;
+    const int samplerate = deadbeef->pl_find_meta_int (it, ":SAMPLERATE", 0);
+    if (!waveform_is_image_key (key)
+        || samplerate <= 0
+        || !waveform_subtrack_range (it, uri, &start, &end, &image_end)) {
+        return 0;
+    }
+    DB_playItem_t *image = waveform_image_item (it, uri, image_end);
+    if (!image) {
+        return 0;
+    }
+
+    // depends on the image alone, so every subtrack resumes the same checkpoint
+    const int num_columns = (int)CLAMP ((int64_t)CONFIG_NUM_SAMPLES * image_end / ((int64_t)samplerate * IMAGE_TRACK_SECONDS), CONFIG_NUM_SAMPLES, MAX_IMAGE_SAMPLES);
+    const size_t data_size = (size_t)num_columns * MAX_CHANNELS * VALUES_PER_SAMPLE;
+    wavedata_t wavedata = {
+        .data = calloc (data_size, sizeof (short)),
+    };
+    if (!wavedata.data) {
+        deadbeef->pl_item_unref (image);
+        return 0;
+    }
+
+    char *preview_decoders = waveform_preview_decoders (priority);
+    waveform_job_t job = {
+        .track = it,
+        .image = uri,
+    };
+    waveform_analysis_t analysis = {
+        .it = image,
+        .key = key,
+        .priority = priority,
+        .num_columns = num_columns,
+        .checkpoints = 1,
+        .preview_decoders = preview_decoders,
+        .progress = waveform_analysis_progress,
+        // a job queued for another subtrack follows the one that plays
+        .focus = waveform_analysis_focus,
+        .mp3_envelope = CONFIG_MP3_ENVELOPE,
+        .idle_io = CONFIG_IDLE_IO,
+        .max_load = CONFIG_MAX_LOAD / 100.f,
+        .min_buffer_ms = CONFIG_MIN_BUFFER,
+        .user_data = &job,
+        .wavedata = &wavedata,
+        .data_size = data_size,
+    };
+    if (waveform_analysis_run (&analysis)) {
+        deadbeef->mutex_lock (cache_mutex);
+        waveform_db_image_write (uri, wavedata.data, wavedata.data_len * sizeof (short), wavedata.channels, num_columns, analysis.total_frames);
+        deadbeef->mutex_unlock (cache_mutex);
+        waveform_analysis_progress (&analysis, 0, num_columns, &job);
+    }
+
+    free (wavedata.data);
+    free (preview_decoders);
+    deadbeef->pl_item_unref (image);
+    return 1;
+}
+
+static void
+waveform_get_wavedata (const char *key, DB_playItem_t *it, int priority)
+{
+    if (!it) {
+        return;
+    }
+
+    deadbeef->pl_lock ();
+    const char *uri_meta = deadbeef->pl_find_meta_raw (it, ":URI");
+    char *uri = uri_meta ? strdup (uri_meta) : NULL;
+    deadbeef->pl_unlock ();
+    if (!uri) {
+        return;
+    }
+
+    deadbeef->background_job_increment ();
+    if (CONFIG_CACHE_ENABLED
+        && waveform_is_cached (it, uri)
+        && (priority == JOB_PRIORITY_BATCH || !waveform_is_approximate (it, uri))) {
+        DB_playItem_t *playing = deadbeef->streamer_get_playing_track ();
+        int64_t start = 0;
+        int64_t end = 0;
+        // the image job may come from another subtrack than the playing one
+        if (playing && (playing == it || (waveform_is_image_key (key) && waveform_image_playing (uri, &start, &end)))) {
+            deadbeef->mutex_lock (widgets_mutex);
+            for (GList *l = widgets; l; l = l->next) {
+                waveform_get_from_cache (l->data, playing, uri);
+                waveform_queue_redraw (l->data);
+            }
+            deadbeef->mutex_unlock (widgets_mutex);
         }
         if (playing) {
             deadbeef->pl_item_unref (playing);
         }
+    }
+    else if (!CONFIG_CACHE_ENABLED || !waveform_analyze_image (key, it, priority, uri)) {
+        waveform_analyze_track (key, it, priority, uri);
+    }
+    if (priority == JOB_PRIORITY_BATCH && !queue_is_cancelled (key)) {
+        // a no-op unless the library indexer queued the file
+        waveform_db_library_done (uri);
+    }
+
+    free (uri);
+    uri = NULL;
+
+    deadbeef->background_job_decrement ();
+}
+
+static int
+waveform_queue_track (DB_playItem_t *it, int priority)
+{
+    deadbeef->pl_lock ();
+    const char *uri_meta = deadbeef->pl_find_meta_raw (it, ":URI");
+    char *uri = uri_meta ? strdup (uri_meta) : NULL;
+    deadbeef->pl_unlock ();
+    if (!uri) {
+        return 0;
+    }
+    // long recordings are still analyzed, but only as background work
+    if (CONFIG_MAX_FILE_LENGTH != -1 && deadbeef->pl_get_item_duration (it)/60 >= CONFIG_MAX_FILE_LENGTH) {
+        priority = MAX (priority, JOB_PRIORITY_BATCH);
+    }
+    int result = 0;
+    if (waveform_valid_track (it, uri)) {
+        // subtracks of one image resolve to the same job
+        char *key = CONFIG_CACHE_ENABLED ? waveform_image_key (it, uri) : NULL;
+        if (!key) {
+            key = waveform_format_uri (it, uri);
+        }
+        if (key) {
+            uint64_t locality = 0;
+            if (priority == JOB_PRIORITY_BATCH && CONFIG_BATCH_LOCALITY && deadbeef->is_local_file (uri)) {
+                locality = waveform_locality (uri);
+            }
+            result = worker_pool_submit (key, it, priority, locality);
+            free (key);
+        }
+    }
+    free (uri);
+    return result;
+}
+
+// Tracks of library files are analyzed in the background, a changed file
+// loses its old results first.
+static int
+waveform_index_queue (DB_playItem_t *it, int changed)
+{
+    if (changed) {
+        deadbeef->pl_lock ();
+        const char *uri_meta = deadbeef->pl_find_meta_raw (it, ":URI");
+        char *uri = uri_meta ? strdup (uri_meta) : NULL;
+        deadbeef->pl_unlock ();
+        if (uri) {
+            waveform_delete (it, uri);
+            free (uri);
+        }
+    }
+    return waveform_queue_track (it, JOB_PRIORITY_BATCH);
+}
+
+static void
+waveform_update_index (void)
+{
+    if (CONFIG_INDEX_ENABLED && CONFIG_CACHE_ENABLED && CONFIG_INDEX_ROOTS[0]) {
+        waveform_index_start (CONFIG_INDEX_ROOTS, waveform_index_queue);
+    }
+    else {
+        waveform_index_stop ();
+    }
+}
 
-        if (wavedata->data) {
-            free (wavedata->data);
-            wavedata->data = NULL;
+// Remembers the items of all playlists that were not seen before. With
+// queue set they are also kept, in playlist order, for analysis.
+static void
+waveform_added_collect (waveform_t *w, int queue)
+{
+    const int count = deadbeef->plt_get_count ();
+    for (int i = 0; i < count; i++) {
+        ddb_playlist_t *plt = deadbeef->plt_get_for_idx (i);
+        if (!plt) {
+            continue;
         }
-        if (wavedata->fname) {
-            free (wavedata->fname);
-            wavedata->fname = NULL;
+        deadbeef->pl_lock ();
+        DB_playItem_t *it = deadbeef->plt_get_first (plt, PL_MAIN);
+        while (it) {
+            char *key = waveform_format_uri (it, deadbeef->pl_find_meta_raw (it, ":URI"));
+            if (key && !g_hash_table_contains (w->added_seen, key)) {
+                g_hash_table_add (w->added_seen, key);
+                key = NULL;
+                if (queue) {
+                    deadbeef->pl_item_ref (it);
+                    g_queue_push_tail (w->added, it);
+                }
+            }
+            free (key);
+            DB_playItem_t *next = deadbeef->pl_get_next (it, PL_MAIN);
+            deadbeef->pl_item_unref (it);
+            it = next;
         }
-        if (wavedata) {
-            free (wavedata);
-            wavedata = NULL;
+        deadbeef->pl_unlock ();
+        deadbeef->plt_unref (plt);
+    }
+}
+
+// Added items go to the workers only while few jobs are pending, so a large
+// import does not crowd out tracks that get played meanwhile.
+static gboolean
+waveform_added_cb (void *user_data)
+{
+    waveform_t *w = user_data;
+    if (g_atomic_int_compare_and_exchange (&w->added_rescan, 1, 0)) {
+        waveform_added_collect (w, 1);
+    }
+    for (int checks = 0;
+         checks < ADDED_MAX_CHECKS && !g_queue_is_empty (w->added) && (!CONFIG_PRELOAD_ADDED || queue_pending () < ADDED_MAX_PENDING);
+         checks++) {
+        DB_playItem_t *it = g_queue_pop_head (w->added);
+        deadbeef->pl_lock ();
+        const char *uri_meta = deadbeef->pl_find_meta_raw (it, ":URI");
+        char *uri = uri_meta ? strdup (uri_meta) : NULL;
+        deadbeef->pl_unlock ();
+        if (CONFIG_PRELOAD_ADDED && uri && !waveform_is_cached (it, uri)) {
+            waveform_queue_track (it, JOB_PRIORITY_BATCH);
         }
+        free (uri);
+        deadbeef->pl_item_unref (it);
     }
 
+    deadbeef->mutex_lock (w->mutex);
+    const int done = g_queue_is_empty (w->added) && !g_atomic_int_get (&w->added_rescan);
+    if (done) {
+        w->addedtimer = 0;
+    }
+    deadbeef->mutex_unlock (w->mutex);
+    return !done;
+}
+
+static void
+waveform_added_schedule (waveform_t *w)
+{
+    deadbeef->mutex_lock (w->mutex);
+    g_atomic_int_set (&w->added_rescan, 1);
+    if (!w->addedtimer) {
+        w->addedtimer = g_timeout_add (ADDED_INTERVAL, waveform_added_cb, w);
+    }
+    deadbeef->mutex_unlock (w->mutex);
+}
+
+// Jobs started for a track that is neither playing nor in the play queue
+// anymore are stopped; batch jobs are left alone.
+static int
+waveform_job_is_stale (const char *key, DB_playItem_t *it, int priority, void *ctx)
+{
+    if (priority == JOB_PRIORITY_BATCH || !it) {
+        return 0;
+    }
+    int64_t start = 0;
+    int64_t end = 0;
+    if (waveform_is_playing (it)
+        || (waveform_is_image_key (key) && waveform_image_playing (key + strlen (IMAGE_KEY_PREFIX), &start, &end))) {
+        return 0;
+    }
+    return deadbeef->playqueue_test (it) == -1;
+}
+
+// Item the streamer is expected to play after it: the head of the play
+// queue, or the following one in playlist or shuffle order. Random order
+// and album shuffle have no predictable next item.
+static DB_playItem_t *
+waveform_next_track (DB_playItem_t *it)
+{
+    if (deadbeef->playqueue_get_count () > 0) {
+        return deadbeef->playqueue_get_item (0);
+    }
+    const int order = deadbeef->conf_get_int ("playback.order", PLAYBACK_ORDER_LINEAR);
+    const int loop = deadbeef->conf_get_int ("playback.loop", PLAYBACK_MODE_LOOP_ALL);
+    if (loop == PLAYBACK_MODE_LOOP_SINGLE) {
+        return NULL;
+    }
+    ddb_playlist_t *plt = deadbeef->pl_get_playlist (it);
+    if (!plt) {
+        return NULL;
+    }
+    DB_playItem_t *next = NULL;
+    if (order == PLAYBACK_ORDER_LINEAR) {
+        next = deadbeef->pl_get_next (it, PL_MAIN);
+        if (!next && loop == PLAYBACK_MODE_LOOP_ALL) {
+            next = deadbeef->plt_get_first (plt, PL_MAIN);
+        }
+    }
+    else if (order == PLAYBACK_ORDER_SHUFFLE_TRACKS) {
+        // the lowest rating above the current one, a wrap reshuffles
+        deadbeef->pl_lock ();
+        DB_playItem_t *item = deadbeef->plt_get_first (plt, PL_MAIN);
+        while (item) {
+            if (item->shufflerating > it->shufflerating && (!next || item->shufflerating < next->shufflerating)) {
+                next = item;
+            }
+            DB_playItem_t *following = deadbeef->pl_get_next (item, PL_MAIN);
+            deadbeef->pl_item_unref (item);
+            item = following;
+        }
+        if (next) {
+            deadbeef->pl_item_ref (next);
+        }
+        deadbeef->pl_unlock ();
+    }
+    deadbeef->plt_unref (plt);
+    return next;
+}
+
+// Gets the waveform of the next track ready: read from the cache now, or
+// analyzed in the background so it is cached by the time it starts.
+static void
+waveform_prefetch_next (waveform_t *w, DB_playItem_t *it)
+{
+    DB_playItem_t *next = CONFIG_PREFETCH_NEXT ? waveform_next_track (it) : NULL;
+    if (next == it) {
+        deadbeef->pl_item_unref (next);
+        next = NULL;
+    }
+    deadbeef->mutex_lock (w->mutex);
+    if (w->next_track) {
+        deadbeef->pl_item_unref (w->next_track);
+    }
+    w->next_track = next;
+    w->next_wave->data_len = 0;
+    w->next_wave->channels = 0;
+    deadbeef->mutex_unlock (w->mutex);
+    if (!next) {
+        return;
+    }
+
+    deadbeef->pl_lock ();
+    const char *uri_meta = deadbeef->pl_find_meta_raw (next, ":URI");
+    char *uri = uri_meta ? strdup (uri_meta) : NULL;
+    deadbeef->pl_unlock ();
+    if (!uri || !waveform_valid_track (next, uri)) {
+        free (uri);
+        return;
+    }
+    if (CONFIG_CACHE_ENABLED && waveform_is_cached (next, uri)) {
+        // estimates and image slices are left to the track change
+        char *key = waveform_format_uri (next, uri);
+        if (key && !waveform_db_approximate (key)) {
+            deadbeef->mutex_lock (w->mutex);
+            if (w->next_track == next) {
+                w->next_wave->data_len = waveform_db_read (key, w->next_wave->data, w->max_buffer_len, &w->next_wave->channels);
+            }
+            deadbeef->mutex_unlock (w->mutex);
+        }
+        free (key);
+    }
+    else {
+        waveform_queue_track (next, JOB_PRIORITY_NEXT);
+    }
     free (uri);
-    uri = NULL;
+}
 
-    deadbeef->pl_item_unref (it);
-    deadbeef->background_job_decrement ();
+// Shows the prefetched waveform if it is for it.
+static int
+waveform_take_next (waveform_t *w, DB_playItem_t *it)
+{
+    deadbeef->mutex_lock (w->mutex);
+    const int found = w->next_track == it && w->next_wave->data_len > 0;
+    if (found) {
+        memcpy (w->wave->data, w->next_wave->data, w->next_wave->data_len * sizeof (short));
+        w->wave->data_len = w->next_wave->data_len;
+        w->wave->channels = w->next_wave->channels;
+    }
+    deadbeef->mutex_unlock (w->mutex);
+    if (found && CONFIG_CACHE_ENABLED) {
+        deadbeef->pl_lock ();
+        const char *uri_meta = deadbeef->pl_find_meta_raw (it, ":URI");
+        char *uri = uri_meta ? strdup (uri_meta) : NULL;
+        deadbeef->pl_unlock ();
+        if (uri) {
+            waveform_features_from_cache (w, it, uri);
+            free (uri);
+        }
+    }
+    return found;
+}
+
+static gboolean
+waveform_dwell_cb (void *user_data)
+{
+    waveform_t *w = user_data;
+    deadbeef->mutex_lock (w->mutex);
+    // a track change may have replaced the timer while this one waited for
+    // the mutex, the track then belongs to the new timer
+    if (w->dwelltimer != g_source_get_id (g_main_current_source ())) {
+        deadbeef->mutex_unlock (w->mutex);
+        return FALSE;
+    }
+    DB_playItem_t *it = w->dwell_track;
+    w->dwell_track = NULL;
+    w->dwelltimer = 0;
+    deadbeef->mutex_unlock (w->mutex);
+    if (it) {
+        if (waveform_is_playing (it)) {
+            waveform_queue_track (it, JOB_PRIORITY_PLAYING);
+            waveform_prefetch_next (w, it);
+        }
+        deadbeef->pl_item_unref (it);
+    }
+    return FALSE;
+}
+
+static int
+waveform_load_from_cache (waveform_t *w, DB_playItem_t *it, int *approximate)
+{
+    if (!CONFIG_CACHE_ENABLED) {
+        return 0;
+    }
+    deadbeef->pl_lock ();
+    const char *uri_meta = deadbeef->pl_find_meta_raw (it, ":URI");
+    char *uri = uri_meta ? strdup (uri_meta) : NULL;
+    deadbeef->pl_unlock ();
+    if (!uri) {
+        return 0;
+    }
+    int result = 0;
+    if (waveform_valid_track (it, uri) && waveform_is_cached (it, uri)) {
+        waveform_get_from_cache (w, it, uri);
+        *approximate = waveform_is_approximate (it, uri);
+        result = 1;
+    }
+    free (uri);
+    return result;
+}
+
+// Cached and prefetched waveforms are shown right away. Decoding only starts once the track
+// stayed current for CONFIG_DECODE_DELAY ms, so skipping through a playlist
+// does not start an analysis for every track passed on the way.
+static void
+waveform_track_changed (waveform_t *w)
+{
+    DB_playItem_t *it = deadbeef->streamer_get_playing_track ();
+    if (!it) {
+        waveform_update_tap (NULL, 0);
+        return;
+    }
+    waveform_set_features (w, NULL, 0, 0, 0);
+    // an MP3 estimate stays on screen until the full analysis replaces it
+    int approximate = 0;
+    if (waveform_take_next (w, it) || (waveform_load_from_cache (w, it, &approximate) && !approximate)) {
+        waveform_update_tap (it, 0);
+        waveform_prefetch_next (w, it);
+        deadbeef->pl_item_unref (it);
+        return;
+    }
+    waveform_update_tap (it, 1);
+
+    deadbeef->mutex_lock (w->mutex);
+    if (!approximate) {
+        memset (w->wave->data, 0, sizeof (short) * w->max_buffer_len);
+        w->wave->data_len = 0;
+        w->wave->channels = 0;
+    }
+    if (w->dwelltimer) {
+        g_source_remove (w->dwelltimer);
+        w->dwelltimer = 0;
+    }
+    if (w->dwell_track) {
+        deadbeef->pl_item_unref (w->dwell_track);
+        w->dwell_track = NULL;
+    }
+    if (CONFIG_DECODE_DELAY > 0) {
+        w->dwell_track = it;
+        w->dwelltimer = g_timeout_add (CONFIG_DECODE_DELAY, waveform_dwell_cb, w);
+        it = NULL;
+    }
+    deadbeef->mutex_unlock (w->mutex);
+
+    if (it) {
+        waveform_queue_track (it, JOB_PRIORITY_PLAYING);
+        waveform_prefetch_next (w, it);
+        deadbeef->pl_item_unref (it);
+    }
 }
 
 static gboolean
@@ -1054,9 +2147,17 @@ waveform_motion_notify_event (GtkWidget *widget, GdkEventButton *event, gpointer
     return TRUE;
 }
 
+static void
+waveform_seek (waveform_t *w, int time)
+{
+    g_atomic_int_set (&seek_target, time);
+    deadbeef->sendmessage (DB_EV_SEEK, 0, time, 0);
+}
+
 static gboolean
 waveform_scroll_event (GtkWidget *widget, GdkEvent *event, gpointer user_data)
 {
+    waveform_t *w = user_data;
     GdkEventScroll *ev = (GdkEventScroll *)event;
     if (!CONFIG_SCROLL_ENABLED) {
         return TRUE;
@@ -1070,10 +2171,10 @@ waveform_scroll_event (GtkWidget *widget, GdkEvent *event, gpointer user_data)
 
         switch (ev->direction) {
             case GDK_SCROLL_UP:
-                deadbeef->sendmessage (DB_EV_SEEK, 0, MIN (duration, time + step), 0);
+                waveform_seek (w, MIN (duration, time + step));
                 break;
             case GDK_SCROLL_DOWN:
-                deadbeef->sendmessage (DB_EV_SEEK, 0, MAX (0, time - step), 0);
+                waveform_seek (w, MAX (0, time - step));
                 break;
             default:
                 break;
@@ -1121,7 +2222,7 @@ waveform_button_release_event (GtkWidget *widget, GdkEventButton *event, gpointe
             GtkAllocation a;
             gtk_widget_get_allocation (w->drawarea, &a);
             const float time = MAX (0, (event->x - a.x) * deadbeef->pl_get_item_duration (trk) / (a.width) * 1000.f);
-            deadbeef->sendmessage (DB_EV_SEEK, 0, time, 0);
+            waveform_seek (w, (int)time);
             deadbeef->pl_item_unref (trk);
         }
         gtk_widget_queue_draw (widget);
@@ -1134,31 +2235,42 @@ static int
 waveform_message (ddb_gtkui_widget_t *widget, uint32_t id, uintptr_t ctx, uint32_t p1, uint32_t p2)
 {
     waveform_t *w = (waveform_t *)widget;
-    intptr_t tid;
 
     switch (id) {
     case DB_EV_SONGSTARTED:
         playback_status = PLAYING;
-        waveform_set_refresh_interval (w, CONFIG_REFRESH_INTERVAL);
-        g_idle_add (waveform_redraw_cb, w);
-        g_idle_add (ruler_redraw_cb, w);
-        tid = deadbeef->thread_start_low_priority (waveform_get_wavedata, w);
-        if (tid) {
-            deadbeef->thread_detach (tid);
+        g_atomic_int_set (&seek_target, -1);
+        w->stream_head = -1;
+        if (!w->drawtimer) {
+            waveform_set_refresh_interval (w, CONFIG_REFRESH_INTERVAL);
         }
+        queue_cancel_matching (waveform_job_is_stale, NULL);
+        waveform_tap_wake ();
+        waveform_track_changed (w);
+        waveform_queue_redraw (w);
+        g_idle_add (ruler_redraw_cb, w);
         break;
     case DB_EV_STOP:
         playback_status = STOPPED;
+        queue_cancel_matching (waveform_job_is_stale, NULL);
+        waveform_update_tap (NULL, 0);
         deadbeef->mutex_lock (w->mutex);
         memset (w->wave->data, 0, sizeof (short) * w->max_buffer_len);
         w->wave->data_len = 0;
         w->wave->channels = 0;
+        w->features_len = 0;
         deadbeef->mutex_unlock (w->mutex);
-        g_idle_add (waveform_redraw_cb, w);
+        waveform_queue_redraw (w);
         g_idle_add (ruler_redraw_cb, w);
         break;
+    case DB_EV_PLAYLISTCHANGED:
+        if (CONFIG_PRELOAD_ADDED && CONFIG_CACHE_ENABLED && p1 == DDB_PLAYLIST_CHANGE_CONTENT) {
+            waveform_added_schedule (w);
+        }
+        break;
     case DB_EV_CONFIGCHANGED:
         on_config_changed (w);
+        waveform_update_index ();
         break;
     case DB_EV_PAUSED:
         if (p1) {
@@ -1176,8 +2288,17 @@ static void
 waveform_destroy (ddb_gtkui_widget_t *widget)
 {
     waveform_t *w = (waveform_t *)widget;
+    // jobs keep running for the other widgets
+    if (widgets_mutex) {
+        deadbeef->mutex_lock (widgets_mutex);
+        widgets = g_list_remove (widgets, w);
+        const int last = !widgets;
+        deadbeef->mutex_unlock (widgets_mutex);
+        if (last) {
+            waveform_tap_stop ();
+        }
+    }
     deadbeef->mutex_lock (w->mutex);
-    waveform_db_close ();
     if (w->drawtimer) {
         g_source_remove (w->drawtimer);
         w->drawtimer = 0;
@@ -1186,6 +2307,42 @@ waveform_destroy (ddb_gtkui_widget_t *widget)
         g_source_remove (w->resizetimer);
         w->resizetimer = 0;
     }
+    if (w->dwelltimer) {
+        g_source_remove (w->dwelltimer);
+        w->dwelltimer = 0;
+    }
+    if (w->dwell_track) {
+        deadbeef->pl_item_unref (w->dwell_track);
+        w->dwell_track = NULL;
+    }
+    if (w->addedtimer) {
+        g_source_remove (w->addedtimer);
+        w->addedtimer = 0;
+    }
+    // redraws still queued by jobs
+    while (g_source_remove_by_user_data (w)) {
+    }
+    if (w->next_track) {
+        deadbeef->pl_item_unref (w->next_track);
+        w->next_track = NULL;
+    }
+    if (w->next_wave) {
+        free (w->next_wave->data);
+        free (w->next_wave);
+        w->next_wave = NULL;
+    }
+    if (w->features) {
+        free (w->features);
+        w->features = NULL;
+    }
+    if (w->added) {
+        g_queue_free_full (w->added, (GDestroyNotify)deadbeef->pl_item_unref);
+        w->added = NULL;
+    }
+    if (w->added_seen) {
+        g_hash_table_destroy (w->added_seen);
+        w->added_seen = NULL;
+    }
     if (w->surf) {
         cairo_surface_destroy (w->surf);
         w->surf = NULL;
@@ -1226,7 +2383,7 @@ waveform_init (ddb_gtkui_widget_t *w)
     load_config ();
     waveform_colors_update (wf);
 
-    wf->max_buffer_len = MAX_SAMPLES * VALUES_PER_SAMPLE * MAX_CHANNELS * sizeof (short);
+    wf->max_buffer_len = MAX_BUFFER_LEN;
     deadbeef->mutex_lock (wf->mutex);
     wf->wave = malloc (sizeof (wavedata_t));
     wf->wave->data = malloc (sizeof (short) * wf->max_buffer_len);
@@ -1234,6 +2391,10 @@ waveform_init (ddb_gtkui_widget_t *w)
     wf->wave->fname = NULL;
     wf->wave->data_len = 0;
     wf->wave->channels = 0;
+    wf->next_wave = calloc (1, sizeof (wavedata_t));
+    wf->next_wave->data = calloc (wf->max_buffer_len, sizeof (short));
+    wf->features = calloc (MAX_SAMPLES * METER_VALUES, sizeof (short));
+    wf->features_len = 0;
     wf->surf = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
                                            a.width,
                                            a.height);
@@ -1246,25 +2407,26 @@ waveform_init (ddb_gtkui_widget_t *w)
     wf->width = a.width;
     wf->pos_last = 0;
 
-    make_cache_dir (cache_path, sizeof (cache_path)/sizeof (char));
-
-    deadbeef->mutex_lock (wf->mutex);
-    waveform_db_open (cache_path);
-    waveform_db_init (NULL);
-    deadbeef->mutex_unlock (wf->mutex);
+    deadbeef->mutex_lock (widgets_mutex);
+    widgets = g_list_append (widgets, wf);
+    deadbeef->mutex_unlock (widgets_mutex);
 
     DB_playItem_t *it = deadbeef->streamer_get_playing_track ();
+    waveform_update_tap (it, 1);
     if (it) {
         playback_status = PLAYING;
-        intptr_t tid = deadbeef->thread_start_low_priority (waveform_get_wavedata, w);
-        if (tid) {
-            deadbeef->thread_detach (tid);
-        }
+        waveform_queue_track (it, JOB_PRIORITY_PLAYING);
         deadbeef->pl_item_unref (it);
     }
     wf->resizetimer = 0;
 
+    // only items added from now on are analyzed ahead of time
+    wf->added = g_queue_new ();
+    wf->added_seen = g_hash_table_new_full (g_str_hash, g_str_equal, free, NULL);
+    waveform_added_collect (wf, 0);
+
     on_config_changed (w);
+    waveform_update_index ();
 }
 
 static ddb_gtkui_widget_t *
@@ -1289,6 +2451,7 @@ waveform_create (void)
     gtk_menu_attach_to_widget (GTK_MENU (w->popup), w->base.widget, NULL);
     w->popup_item = gtk_menu_item_new_with_mnemonic ("Configure");
     w->mutex = deadbeef->mutex_create ();
+    w->stream_head = -1;
     gtk_widget_set_size_request (w->base.widget, 300, 96);
     gtk_widget_set_size_request (w->ruler, -1, 20);
     gtk_widget_set_size_request (w->drawarea, -1, -1);
@@ -1348,6 +2511,15 @@ static int
 waveform_start (void)
 {
     load_config ();
+    widgets_mutex = deadbeef->mutex_create ();
+    cache_mutex = deadbeef->mutex_create ();
+    make_cache_dir (cache_path, sizeof (cache_path)/sizeof (char));
+    waveform_remote_cleanup (cache_path);
+    waveform_db_open (cache_path);
+    waveform_db_init (NULL);
+    waveform_tap_init ();
+    queue_init ();
+    worker_pool_start (CONFIG_NUM_WORKERS, CONFIG_BATCH_READERS, waveform_get_wavedata);
     return 0;
 }
 
@@ -1355,6 +2527,18 @@ static int
 waveform_stop (void)
 {
     save_config ();
+    waveform_index_stop ();
+    queue_cancel_all ();
+    // wakes jobs waiting for the tap
+    waveform_tap_stop ();
+    worker_pool_stop ();
+    waveform_tap_free ();
+    waveform_db_close ();
+    queue_free ();
+    deadbeef->mutex_free (cache_mutex);
+    deadbeef->mutex_free (widgets_mutex);
+    cache_mutex = 0;
+    widgets_mutex = 0;
     return 0;
 }
 
@@ -1435,10 +2619,34 @@ static const char settings_dlg[] =
     "property \"Border width: \"                    spinbtn[0,1,1] "            CONFSTR_WF_BORDER_WIDTH         " 1 ;\n"
     "property \"Cursor width: \"                    spinbtn[0,3,1] "            CONFSTR_WF_CURSOR_WIDTH         " 3 ;\n"
     "property \"Font size: \"                       spinbtn[8,20,1] "           CONFSTR_WF_FONT_SIZE           " 18 ;\n"
-    "property \"Ignore files longer than x minutes "
-                "(-1 scans every file): \"          spinbtn[-1,9999,1] "        CONFSTR_WF_MAX_FILE_LENGTH    " 180 ;\n"
+    "property \"Analyze files longer than x minutes "
+                "in background (-1 disables): \"   spinbtn[-1,9999,1] "        CONFSTR_WF_MAX_FILE_LENGTH    " 180 ;\n"
     "property \"Use cache \"                        checkbox "                  CONFSTR_WF_CACHE_ENABLED        " 1 ;\n"
     "property \"Scroll wheel to seek \"             checkbox "                  CONFSTR_WF_SCROLL_ENABLED       " 1 ;\n"
+    "property \"Analysis threads: \"                spinbtn[1,16,1] "           CONFSTR_WF_NUM_WORKERS          " 2 ;\n"
+    "property \"Delay analysis after track change (ms): \" spinbtn[0,5000,50] " CONFSTR_WF_DECODE_DELAY       " 300 ;\n"
+    "property \"Quick preview before full analysis \" checkbox "                CONFSTR_WF_PREVIEW_ENABLED      " 1 ;\n"
+    "property \"Build waveform from playback, decode skipped parts only \" checkbox " CONFSTR_WF_PLAYBACK_TAP   " 0 ;\n"
+    "property \"Estimate MP3 files from frame headers first \" checkbox "       CONFSTR_WF_MP3_ENVELOPE         " 0 ;\n"
+    "property \"Idle I/O priority for background analysis \" checkbox "         CONFSTR_WF_IDLE_IO              " 1 ;\n"
+    "property \"Pause background analysis above load per CPU (%, 0 disables): \" spinbtn[0,1000,10] " CONFSTR_WF_MAX_LOAD " 150 ;\n"
+    "property \"Pause analysis below playback buffer (ms, 0 disables): \" spinbtn[0,5000,100] " CONFSTR_WF_MIN_BUFFER " 500 ;\n"
+    "property \"Analyze music library in background \" checkbox "               CONFSTR_WF_INDEX_ENABLED        " 0 ;\n"
+    "property \"Library folders (separated by ;): \" entry "                   CONFSTR_WF_INDEX_ROOTS          " \"\" ;\n"
+    "property \"Analyze tracks when added to a playlist \" checkbox "          CONFSTR_WF_PRELOAD_ADDED        " 0 ;\n"
+    "property \"Prepare the next track's waveform \" checkbox "                CONFSTR_WF_PREFETCH_NEXT        " 1 ;\n"
+    "property \"Background files read in parallel: \"  spinbtn[1,16,1] "       CONFSTR_WF_BATCH_READERS        " 2 ;\n"
+    "property \"Read background files in disk order \" checkbox "              CONFSTR_WF_BATCH_LOCALITY       " 1 ;\n"
+    "property \"Analyze network files (HTTP, SMB, ...) \" checkbox "          CONFSTR_WF_REMOTE_ENABLED       " 0 ;\n"
+    "property \"Network download limit (KiB/s, 0 = none): \" spinbtn[0,102400,64] " CONFSTR_WF_REMOTE_RATE      " 512 ;\n"
+    "property \"Largest network file copied (MiB, 0 = none): \" spinbtn[0,16384,64] " CONFSTR_WF_REMOTE_MAX_SIZE " 512 ;\n"
+    "property \"Measure true peak, clipping and loudness \" checkbox "       CONFSTR_WF_METERS_ENABLED       " 0 ;\n"
+    "property \"Mark clipping \" checkbox "                                  CONFSTR_WF_SHOW_CLIPS           " 1 ;\n"
+    "property \"Show short-term loudness \" checkbox "                       CONFSTR_WF_SHOW_LOUDNESS        " 0 ;\n"
+    "property \"Color by spectral balance (lows red, mids green, highs blue) \" checkbox " CONFSTR_WF_BAND_COLORS " 0 ;\n"
+    "property \"Rolling waveform for streams \" checkbox "                     CONFSTR_WF_STREAM_ENABLED       " 1 ;\n"
+    "property \"Stream window (minutes): \" spinbtn[1,60,1] "                   CONFSTR_WF_STREAM_WINDOW        " 5 ;\n"
+    "property \"Preview decoders (cheap seeking): \" entry "                    CONFSTR_WF_PREVIEW_DECODERS     " \"" CONFIG_PREVIEW_DECODERS_DEFAULT "\" ;\n"
     "property \"Number of samples (per channel): \" spinbtn[2048,4092,2048] "   CONFSTR_WF_NUM_SAMPLES       " 2048 ;\n"
 ;
 
@@ -33,6 +33,10 @@
 
 extern DB_functions_t *deadbeef;
 
+// min, max, rms
+#define VALUES_PER_SAMPLE (3)
+#define MAX_CHANNELS (6)
+
 typedef struct wavedata_s
 {
     char *fname;
@@ -0,0 +1,221 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    Based on sndfile-tools waveform by Erik de Castro Lopo.
+        waveform.c - v1.04
+        Copyright (C) 2007-2012 Erik de Castro Lopo <erikd@mega-nerd.com>
+        Copyright (C) 2012 Robin Gareus <robin@gareus.org>
+        Copyright (C) 2013 driedfruit <driedfruit@mindloop.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <deadbeef/deadbeef.h>
+
+#include "waveform.h"
+#include "utils.h"
+#include "worker.h"
+
+#define WORKERS_MAX (16)
+#define WORKERS_CLAMP(X) ((X) < 1 ? 1 : ((X) > WORKERS_MAX ? WORKERS_MAX : (X)))
+
+static uintptr_t mutex = 0;
+static uintptr_t cond = 0;
+static worker_job_func job_func;
+static int stopping;
+static int num_running;
+static int num_target;
+static int num_idle;
+// running jobs waiting in worker_pool_block, each has a stand-in worker
+static int num_blocked;
+// batch jobs running and how many may run at once
+static int num_batch;
+static int batch_limit;
+
+static void
+worker_run_job (char *key, DB_playItem_t *it, int priority)
+{
+    trace ("waveform: worker running job %d (%s)\n", priority, key);
+    job_func (key, it, priority);
+    if (queue_pop (key)) {
+        // pushed again while it was being cancelled
+        deadbeef->mutex_lock (mutex);
+        deadbeef->cond_signal (cond);
+        deadbeef->mutex_unlock (mutex);
+    }
+    if (it) {
+        deadbeef->pl_item_unref (it);
+    }
+    free (key);
+}
+
+static void
+worker_thread (void *ctx)
+{
+    deadbeef->mutex_lock (mutex);
+    for (;;) {
+        if (stopping || num_running > num_target + num_blocked) {
+            break;
+        }
+        DB_playItem_t *it = NULL;
+        int priority = JOB_PRIORITY_BATCH;
+        char *key = num_batch < batch_limit ? queue_take (&it, &priority) : queue_take_urgent (JOB_PRIORITY_BATCH, &it, &priority);
+        if (!key) {
+            num_idle++;
+            deadbeef->cond_wait (cond, mutex);
+            num_idle--;
+            continue;
+        }
+        const int batch = priority >= JOB_PRIORITY_BATCH;
+        num_batch += batch;
+        deadbeef->mutex_unlock (mutex);
+        worker_run_job (key, it, priority);
+        deadbeef->mutex_lock (mutex);
+        if (batch) {
+            num_batch--;
+            deadbeef->cond_broadcast (cond);
+        }
+    }
+    num_running--;
+    deadbeef->cond_broadcast (cond);
+    deadbeef->mutex_unlock (mutex);
+}
+
+static void
+worker_pool_spawn (void)
+{
+    while (num_running < num_target + num_blocked) {
+        intptr_t tid = deadbeef->thread_start_low_priority (worker_thread, NULL);
+        if (!tid) {
+            break;
+        }
+        deadbeef->thread_detach (tid);
+        num_running++;
+    }
+}
+
+void
+worker_pool_start (int num_workers, int batch_workers, worker_job_func func)
+{
+    if (!mutex) {
+        mutex = deadbeef->mutex_create_nonrecursive ();
+        cond = deadbeef->cond_create ();
+    }
+    deadbeef->mutex_lock (mutex);
+    job_func = func;
+    stopping = 0;
+    num_blocked = 0;
+    num_target = WORKERS_CLAMP (num_workers);
+    batch_limit = WORKERS_CLAMP (batch_workers);
+    worker_pool_spawn ();
+    deadbeef->mutex_unlock (mutex);
+}
+
+void
+worker_pool_set_size (int num_workers, int batch_workers)
+{
+    if (!mutex) {
+        return;
+    }
+    deadbeef->mutex_lock (mutex);
+    if (!stopping) {
+        num_target = WORKERS_CLAMP (num_workers);
+        batch_limit = WORKERS_CLAMP (batch_workers);
+        worker_pool_spawn ();
+        // surplus workers exit once they are idle
+        deadbeef->cond_broadcast (cond);
+    }
+    deadbeef->mutex_unlock (mutex);
+}
+
+void
+worker_pool_stop (void)
+{
+    if (!mutex) {
+        return;
+    }
+    deadbeef->mutex_lock (mutex);
+    stopping = 1;
+    deadbeef->cond_broadcast (cond);
+    while (num_running > 0) {
+        deadbeef->cond_wait (cond, mutex);
+    }
+    deadbeef->mutex_unlock (mutex);
+    deadbeef->cond_free (cond);
+    deadbeef->mutex_free (mutex);
+    cond = 0;
+    mutex = 0;
+}
+
+int
+worker_pool_submit (const char *key, DB_playItem_t *it, int priority, uint64_t locality)
+{
+    if (!mutex || !queue_push (key, it, priority, locality)) {
+        return 0;
+    }
+    deadbeef->mutex_lock (mutex);
+    deadbeef->cond_signal (cond);
+    deadbeef->mutex_unlock (mutex);
+    return 1;
+}
+
+// the surplus worker exits once it is idle again
+void
+worker_pool_block (int blocked)
+{
+    if (!mutex) {
+        return;
+    }
+    deadbeef->mutex_lock (mutex);
+    num_blocked += blocked ? 1 : -1;
+    if (blocked && !stopping) {
+        worker_pool_spawn ();
+    }
+    else {
+        deadbeef->cond_broadcast (cond);
+    }
+    deadbeef->mutex_unlock (mutex);
+}
+
+// Called by running jobs between chunks. When every worker is busy and more
+// urgent work is pending, that work is run on the calling thread before the
+// current job continues.
+void
+worker_pool_yield (int priority)
+{
+    if (!mutex || priority == JOB_PRIORITY_PLAYING) {
+        return;
+    }
+    for (;;) {
+        deadbeef->mutex_lock (mutex);
+        const int busy = num_idle == 0 && !stopping;
+        deadbeef->mutex_unlock (mutex);
+        if (!busy) {
+            return;
+        }
+        DB_playItem_t *it = NULL;
+        int job_priority = priority;
+        char *key = queue_take_urgent (priority, &it, &job_priority);
+        if (!key) {
+            return;
+        }
+        worker_run_job (key, it, job_priority);
+    }
+}
@@ -0,0 +1,65 @@
+/*
+    Waveform seekbar plugin for the DeaDBeeF audio player
+
+    Copyright (C) 2014 Christian Boxdörfer <christian.boxdoerfer@posteo.de>
+
+    Based on sndfile-tools waveform by Erik de Castro Lopo.
+        waveform.c - v1.04
+        Copyright (C) 2007-2012 Erik de Castro Lopo <erikd@mega-nerd.com>
+        Copyright (C) 2012 Robin Gareus <robin@gareus.org>
+        Copyright (C) 2013 driedfruit <driedfruit@mindloop.net>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef WORKER_HEADER
+#define WORKER_HEADER
+
+#include <deadbeef/deadbeef.h>
+
+// Lower values are handed to workers first.
+enum JOB_PRIORITY {
+    JOB_PRIORITY_PLAYING = 0,
+    JOB_PRIORITY_NEXT = 1,
+    JOB_PRIORITY_BATCH = 2,
+};
+
+typedef void (*worker_job_func) (const char *key, DB_playItem_t *it, int priority);
+
+// At most batch_workers of the workers run batch jobs at the same time, the
+// others stay available for more urgent work.
+void
+worker_pool_start (int num_workers, int batch_workers, worker_job_func func);
+
+void
+worker_pool_set_size (int num_workers, int batch_workers);
+
+void
+worker_pool_stop (void);
+
+// A non-zero locality orders the job among those of its priority by disk
+// position, see queue_push.
+int
+worker_pool_submit (const char *key, DB_playItem_t *it, int priority, uint64_t locality);
+
+void
+worker_pool_yield (int priority);
+
+// Called around a wait of a running job that may last long, another worker
+// runs jobs in its place meanwhile.
+void
+worker_pool_block (int blocked);
+
+#endif